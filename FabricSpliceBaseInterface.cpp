@@ -2,12 +2,15 @@
 #include "FabricSpliceEditorWidget.h"
 #include "FabricSpliceBaseInterface.h"
 #include "FabricSpliceMayaData.h"
+#include "FabricSpliceInvalidationQueue.h"
+#include "FabricSplicePersistence.h"
 // #include "plugin.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <string.h>
 
 #include <maya/MGlobal.h>
 #include <maya/MFnDependencyNode.h>
@@ -23,8 +26,15 @@
 #include <maya/MFileObject.h>
 #include <maya/MFnPluginData.h>
 #include <maya/MAnimControl.h>
+#include <maya/MObjectHandle.h>
+#if _SPLICE_MAYA_VERSION >= 2016
+#include <maya/MEvaluationManager.h>
+#endif
 
 std::vector<FabricSpliceBaseInterface*> FabricSpliceBaseInterface::_instances;
+std::vector<FabricSpliceBaseInterface*> FabricSpliceBaseInterface::_addedInstances;
+int FabricSpliceBaseInterface::_gatherAddedInstancesDepth = 0;
+MSpinLock FabricSpliceBaseInterface::_instancesLock;
 #if _SPLICE_MAYA_VERSION < 2013
   std::map<std::string, int> FabricSpliceBaseInterface::_nodeCreatorCounts;
 #endif
@@ -35,11 +45,31 @@ FabricSpliceBaseInterface::FabricSpliceBaseInterface(){
   MAYASPLICE_CATCH_BEGIN(&stat);
 
   _restoredFromPersistenceData = false;
+  _restoreDeferred = false;
   _dummyValue = 17;
   _spliceGraph = FabricSplice::DGGraph();
   _spliceGraph.setUserPointer(this);
   _isTransferingInputs = false;
+  _portBindingsDirty = true;
+  _portBindingHashCollision = false;
+  _dirtyGeneration = 1;
+  _evaluatedGeneration = 0;
+#if _SPLICE_MAYA_VERSION >= 2016
+  _preEvaluated = false;
+#endif
+  _evaluatingThread = NULL;
+  _prefetcher = NULL;
+  _evalContextDirty = true;
+  _hasEvalContextTime = false;
+  _persistenceGeneration = 0;
+  _storedPersistenceGeneration = 0;
+  _hasStoredPersistenceData = false;
+  _hasPersistedOutputs = false;
+  _evalContextTime = 0.0;
+  _nameChangedCallbackId = 0;
+  _instancesLock.lock();
   _instances.push_back(this);
+  _instancesLock.unlock();
   _dgDirtyEnabled = true;
   _portObjectsDestroyed = false;
 
@@ -47,6 +77,12 @@ FabricSpliceBaseInterface::FabricSpliceBaseInterface(){
 }
 
 FabricSpliceBaseInterface::~FabricSpliceBaseInterface(){
+  if(_prefetcher)
+    delete(_prefetcher);
+  if(_nameChangedCallbackId != 0)
+    MMessage::removeCallback(_nameChangedCallbackId);
+
+  _instancesLock.lock();
   for(size_t i=0;i<_instances.size();i++){
     if(_instances[i] == this){
       std::vector<FabricSpliceBaseInterface*>::iterator iter = _instances.begin() + i;
@@ -54,6 +90,13 @@ FabricSpliceBaseInterface::~FabricSpliceBaseInterface(){
       break;
     }
   }
+  for(size_t i=0;i<_addedInstances.size();i++){
+    if(_addedInstances[i] == this){
+      _addedInstances.erase(_addedInstances.begin() + i);
+      break;
+    }
+  }
+  _instancesLock.unlock();
 }
 
 void FabricSpliceBaseInterface::constructBaseInterface(){
@@ -81,12 +124,18 @@ void FabricSpliceBaseInterface::constructBaseInterface(){
   _spliceGraph = FabricSplice::DGGraph("mayaGraph");
   _spliceGraph.constructDGNode("DGNode");
 
+  MObject thisMObject = getThisMObject();
+  _nameChangedCallbackId = MNodeMessage::addNameChangedCallback(thisMObject, onNodeNameChanged, this);
+
   MAYASPLICE_CATCH_END(&stat);
 
 }
 
 std::vector<FabricSpliceBaseInterface*> FabricSpliceBaseInterface::getInstances(){
-  return _instances;
+  _instancesLock.lock();
+  std::vector<FabricSpliceBaseInterface*> instances = _instances;
+  _instancesLock.unlock();
+  return instances;
 }
 
 FabricSpliceBaseInterface * FabricSpliceBaseInterface::getInstanceByName(const std::string & name) {
@@ -96,16 +145,76 @@ FabricSpliceBaseInterface * FabricSpliceBaseInterface::getInstanceByName(const s
   MObject spliceMayaNodeObj;
   selList.getDependNode(0, spliceMayaNodeObj);
 
-  for(size_t i=0;i<_instances.size();i++)
+  return getInstanceByObject(spliceMayaNodeObj);
+}
+
+FabricSpliceBaseInterface * FabricSpliceBaseInterface::getInstanceByObject(const MObject & node) {
+  if(node.isNull())
+    return NULL;
+
+  std::vector<FabricSpliceBaseInterface*> instances = getInstances();
+  for(size_t i=0;i<instances.size();i++)
   {
-    if(_instances[i]->getThisMObject() == spliceMayaNodeObj)
+    if(instances[i]->getThisMObject() == node)
     {
-      return _instances[i];
+      return instances[i];
     }
   }
   return NULL;
 }
 
+void FabricSpliceBaseInterface::beginGatherAddedInstances() {
+  _instancesLock.lock();
+  if(_gatherAddedInstancesDepth == 0)
+    _addedInstances.clear();
+  _gatherAddedInstancesDepth++;
+  _instancesLock.unlock();
+}
+
+std::vector<FabricSpliceBaseInterface*> FabricSpliceBaseInterface::endGatherAddedInstances() {
+  std::vector<FabricSpliceBaseInterface*> instances;
+  _instancesLock.lock();
+  if(_gatherAddedInstancesDepth > 0)
+    _gatherAddedInstancesDepth--;
+  if(_gatherAddedInstancesDepth == 0){
+    instances = _addedInstances;
+    _addedInstances.clear();
+  }
+  _instancesLock.unlock();
+  return instances;
+}
+
+void FabricSpliceBaseInterface::clearAddedInstances() {
+  _instancesLock.lock();
+  _addedInstances.clear();
+  _gatherAddedInstancesDepth = 0;
+  _instancesLock.unlock();
+}
+
+void FabricSpliceBaseInterface::clearConversionCaches() {
+  std::vector<FabricSpliceBaseInterface*> instances = getInstances();
+  for(size_t i = 0; i < instances.size(); ++i){
+    FabricSpliceBaseInterface * node = instances[i];
+    EvaluationScope scope(node);
+    for(size_t j = 0; j < node->_portBindings.size(); ++j)
+      node->_portBindings[j].conversionCache.clear();
+  }
+}
+
+bool FabricSpliceBaseInterface::beginEvaluation(){
+  void * thread = mayaThreadTag();
+  if(_evaluatingThread == thread)
+    return false;
+  _evaluationLock.lock();
+  _evaluatingThread = thread;
+  return true;
+}
+
+void FabricSpliceBaseInterface::endEvaluation(){
+  _evaluatingThread = NULL;
+  _evaluationLock.unlock();
+}
+
 void FabricSpliceBaseInterface::transferInputValuesToSplice(MDataBlock& data){
   if(_isTransferingInputs)
     return;
@@ -116,51 +225,284 @@ void FabricSpliceBaseInterface::transferInputValuesToSplice(MDataBlock& data){
 
   _isTransferingInputs = true;
 
-  MFnDependencyNode thisNode(getThisMObject());
+  if(_portBindingsDirty)
+    rebuildPortBindings();
 
-  for(int i = 0; i < _dirtyPlugs.length(); ++i){
-    MString plugName = _dirtyPlugs[i];
-    MPlug plug = thisNode.findPlug(plugName);
-    if(!plug.isNull()){
-      FabricSplice::DGPort port = _spliceGraph.getDGPort(plugName.asChar());
-      if(!port.isValid())
-        continue;
-      if(port.getMode() != FabricSplice::Port_Mode_OUT){
+  MObject thisMObject = getThisMObject();
 
-        std::string dataType = port.getDataType();
-        for(size_t j=0;j<mSpliceMayaDataOverride.size();j++)
-        {
-          if(mSpliceMayaDataOverride[j] == plugName.asChar())
-          {
-            dataType = "SpliceMayaData";
-            break;
-          }
-        }
-        
-        SplicePlugToPortFunc func = getSplicePlugToPortFunc(dataType, &port);
-        if(func != NULL)
-          (*func)(plug, data, port);
-      }
-    }
+  for(size_t i = 0; i < _dirtyPortBindings.size(); ++i){
+    size_t index = _dirtyPortBindings[i];
+    _dirtyPortBindingFlags[index] = 0;
+
+    PortBinding & binding = _portBindings[index];
+    if(binding.plugToPort == NULL)
+      continue;
+
+    MPlug plug(thisMObject, binding.attribute);
+    if(binding.cachedPlugToPort != NULL)
+      (*binding.cachedPlugToPort)(plug, data, binding.port, &binding.conversionCache);
+    else
+      (*binding.plugToPort)(plug, data, binding.port);
   }
 
-  _dirtyPlugs.clear();
+  _dirtyPortBindings.clear();
   _isTransferingInputs = false;
 }
 
-void FabricSpliceBaseInterface::evaluate(){
-  MFnDependencyNode thisNode(getThisMObject());
+MTime FabricSpliceBaseInterface::getEvaluationTime(MDataBlock& data){
+  MDGContext context = data.context();
+  MTime time;
+  if(context.isNormal() || context.getTime(time) != MS::kSuccess)
+    return MAnimControl::currentTime();
+  return time;
+}
 
+void FabricSpliceBaseInterface::invalidateEvaluation(){
+  if(_portBindingsDirty)
+    rebuildPortBindings();
+
+  // all inputs need to be transfered again and all outputs converted
+  _dirtyGeneration++;
+  for(size_t i = 0; i < _portBindings.size(); ++i){
+    _portBindings[i].hasLastValue = false;
+    if(_portBindings[i].portMode != FabricSplice::Port_Mode_OUT)
+      markPortBindingDirty(i);
+  }
+}
+
+bool FabricSpliceBaseInterface::isDirtyTracked(const MDGContext & context) const{
+  if(!context.isNormal())
+    return false;
+#if _SPLICE_MAYA_VERSION >= 2016
+  if(MEvaluationManager::evaluationManagerActive(context) && !_preEvaluated)
+    return false;
+#endif
+  return true;
+}
+
+#if _SPLICE_MAYA_VERSION >= 2016
+void FabricSpliceBaseInterface::preEvaluation(const MDGContext & context, const MEvaluationNode & evaluationNode){
+  FabricSplice::Logging::AutoTimer timer("Maya::preEvaluation()");
+
+  // don't touch the bindings while another thread evaluates the node
+  EvaluationScope scope(this);
+
+  MStatus stat;
+  MAYASPLICE_CATCH_BEGIN(&stat);
+
+  if(!context.isNormal()){
+    invalidateEvaluation();
+    return;
+  }
+  _preEvaluated = true;
+
+  if(_portBindingsDirty)
+    rebuildPortBindings();
+
+  // the node is only evaluated for a change, even if none of the ports
+  // is dirty (evalID, time etc)
+  _dirtyGeneration++;
+
+  MObject thisMObject = getThisMObject();
+  for(size_t i = 0; i < _portBindings.size(); ++i){
+    PortBinding & binding = _portBindings[i];
+    if(binding.portMode == FabricSplice::Port_Mode_OUT)
+      continue;
+
+    bool dirty = evaluationNode.dirtyPlugExists(binding.attribute);
+    if(!dirty && binding.attribute.hasFn(MFn::kCompoundAttribute)){
+      MFnCompoundAttribute compound(binding.attribute);
+      for(unsigned int j = 0; j < compound.numChildren() && !dirty; ++j)
+        dirty = evaluationNode.dirtyPlugExists(compound.child(j));
+    }
+    if(dirty)
+      collectDirtyPlug(MPlug(thisMObject, binding.attribute));
+  }
+
+  MAYASPLICE_CATCH_END(&stat);
+}
+#endif
+
+void FabricSpliceBaseInterface::evaluate(const MTime & time){
   FabricSplice::Logging::AutoTimer timer("Maya::evaluate()");
   managePortObjectValues(false); // recreate objects if not there yet
 
-  // setup the context
+  // setup the context, the host and graph only change on a rename
   FabricCore::RTVal context = _spliceGraph.getEvalContext();
-  context.setMember("host", FabricSplice::constructStringRTVal("Maya"));
-  context.setMember("graph", FabricSplice::constructStringRTVal(thisNode.name().asChar()));
-  context.setMember("time", FabricSplice::constructFloat32RTVal(MAnimControl::currentTime().as(MTime::kSeconds)));
+  if(_evalContextDirty){
+    MFnDependencyNode thisNode(getThisMObject());
+    context.setMember("host", FabricSplice::constructStringRTVal("Maya"));
+    context.setMember("graph", FabricSplice::constructStringRTVal(thisNode.name().asChar()));
+    _evalContextDirty = false;
+    _hasEvalContextTime = false;
+  }
+
+  double seconds = time.as(MTime::kSeconds);
+  if(!_hasEvalContextTime || _evalContextTime != seconds){
+    context.setMember("time", FabricSplice::constructFloat32RTVal(seconds));
+    _evalContextTime = seconds;
+    _hasEvalContextTime = true;
+  }
+
+  flushDirtyInputs(context);
 
   _spliceGraph.evaluate();
+  _evaluatedGeneration = _dirtyGeneration;
+
+  // the values of persisted io and out ports change with the evaluation
+  if(_hasPersistedOutputs)
+    _persistenceGeneration++;
+}
+
+void FabricSpliceBaseInterface::flushDirtyInputs(FabricCore::RTVal & context){
+  if(_pendingDirtyInputs.size() == 0)
+    return;
+
+  FabricSplice::Logging::AutoTimer timer("Maya::flushDirtyInputs()");
+
+  std::vector<FabricCore::RTVal> args(2);
+  for(std::set< std::pair<size_t, int> >::iterator it = _pendingDirtyInputs.begin(); it != _pendingDirtyInputs.end(); ++it){
+    PortBinding & binding = _portBindings[it->first];
+    if(!binding.nameRTVal.isValid())
+      binding.nameRTVal = FabricSplice::constructStringRTVal(binding.portName.c_str());
+    args[0] = binding.nameRTVal;
+    if(it->second >= 0){
+      args[1] = FabricSplice::constructSInt32RTVal(it->second);
+      context.callMethod("", "_addDirtyInput", 2, &args[0]);
+    }
+    else
+      context.callMethod("", "_addDirtyInput", 1, &args[0]);
+  }
+  _pendingDirtyInputs.clear();
+}
+
+void FabricSpliceBaseInterface::onNodeNameChanged(MObject &node, const MString &prevName, void *clientData){
+  FabricSpliceBaseInterface * interf = (FabricSpliceBaseInterface *)clientData;
+  interf->_evalContextDirty = true;
+}
+
+void FabricSpliceBaseInterface::evaluateCached(const MTime & time, bool isNormalContext){
+  std::vector<FabricSpliceEvaluationCache::Port> inputs;
+  std::vector<FabricSpliceEvaluationCache::Port> outputs;
+  if(!_evaluationCache.isEnabled() || !getEvaluationCachePorts(inputs, outputs)){
+    evaluate(time);
+    return;
+  }
+
+  FabricSplice::Logging::AutoTimer timer("Maya::evaluateCached()");
+  managePortObjectValues(false); // recreate objects if not there yet
+
+  if(_evaluationCache.fetch(time.as(MTime::kSeconds), inputs, outputs)){
+    _evaluatedGeneration = _dirtyGeneration;
+  }
+  else{
+    evaluate(time);
+    _evaluationCache.store(outputs);
+  }
+
+  // scheduling looks up the animation curves driving the inputs, the
+  // DG can only be queried like that from the main thread
+  if(_prefetcher && isNormalContext && mayaIsMainThread() && MAnimControl::isPlaying())
+    _prefetcher->schedule(_spliceGraph, getThisMObject(), time, inputs, outputs);
+}
+
+// evaluates the node at each of the times, pulling the inputs through a
+// context of the sample's time, and returns the values of the output
+// ports per sample as JSON.
+MStringArray FabricSpliceBaseInterface::evaluateSamples(const std::vector<MTime> & times, MStatus *stat){
+  MStringArray results;
+  MAYASPLICE_CATCH_BEGIN(stat);
+
+  FabricSplice::Logging::AutoTimer timer("Maya::evaluateSamples()");
+
+  if(_portBindingsDirty)
+    rebuildPortBindings();
+
+  // any output plug triggers the evaluation of all outputs
+  MObject thisMObject = getThisMObject();
+  MPlug outputPlug;
+  for(size_t i = 0; i < _portBindings.size(); ++i){
+    if(_portBindings[i].portMode == FabricSplice::Port_Mode_IN)
+      continue;
+    MPlug plug(thisMObject, _portBindings[i].attribute);
+    if(outputPlug.isNull() || outputPlug.isArray())
+      outputPlug = plug;
+  }
+  if(outputPlug.isNull()){
+    mayaLogErrorFunc("Node '"+MFnDependencyNode(thisMObject).name()+"' has no output ports to sample.");
+    if(stat)
+      *stat = MS::kFailure;
+    return results;
+  }
+
+  for(size_t i = 0; i < times.size(); ++i){
+    MDGContext context(times[i]);
+    MDataHandle handle = outputPlug.asMDataHandle(context);
+    outputPlug.destructHandle(handle);
+
+    FabricCore::Variant sample = FabricCore::Variant::CreateDict();
+    FabricCore::Variant ports = FabricCore::Variant::CreateDict();
+    for(size_t j = 0; j < _portBindings.size(); ++j){
+      PortBinding & binding = _portBindings[j];
+      if(binding.portMode == FabricSplice::Port_Mode_IN)
+        continue;
+      ports.setDictValue(binding.portName.c_str(), binding.port.getVariant());
+    }
+    sample.setDictValue("time", FabricCore::Variant::CreateFloat64(times[i].as(MTime::kSeconds)));
+    sample.setDictValue("ports", ports);
+    results.append(sample.getJSONEncoding().getStringData());
+  }
+
+  MAYASPLICE_CATCH_END(stat);
+  return results;
+}
+
+void FabricSpliceBaseInterface::setPrefetchFrames(unsigned int frames){
+  if(frames == 0){
+    if(_prefetcher)
+      delete(_prefetcher);
+    _prefetcher = NULL;
+    return;
+  }
+
+  // the prefetched frames are served through the evaluation cache
+  _evaluationCache.setEnabled(true);
+  if(!_prefetcher)
+    _prefetcher = new FabricSplicePrefetcher(&_evaluationCache);
+  _prefetcher->setFrameCount(frames);
+}
+
+unsigned int FabricSpliceBaseInterface::getPrefetchFrames() const{
+  return _prefetcher ? _prefetcher->getFrameCount() : 0;
+}
+
+unsigned int FabricSpliceBaseInterface::getPrefetchedCount() const{
+  return _prefetcher ? _prefetcher->getPrefetchedCount() : 0;
+}
+
+bool FabricSpliceBaseInterface::getEvaluationCachePorts(std::vector<FabricSpliceEvaluationCache::Port> & inputs, std::vector<FabricSpliceEvaluationCache::Port> & outputs){
+  if(_portBindingsDirty)
+    rebuildPortBindings();
+
+  // ports without an attribute might carry state from one evaluation
+  // to the next, which can't be cached.
+  if(_portBindings.size() != _spliceGraph.getDGPortCount())
+    return false;
+
+  for(size_t i = 0; i < _portBindings.size(); ++i){
+    PortBinding & binding = _portBindings[i];
+    FabricSpliceEvaluationCache::Port cachePort;
+    cachePort.port = binding.port;
+    cachePort.valueSize = getSpliceDataTypePODSize(binding.dataType);
+    if(cachePort.valueSize == 0)
+      return false;
+
+    if(binding.portMode != FabricSplice::Port_Mode_OUT)
+      inputs.push_back(cachePort);
+    if(binding.portMode != FabricSplice::Port_Mode_IN)
+      outputs.push_back(cachePort);
+  }
+  return true;
 }
 
 void FabricSpliceBaseInterface::transferOutputValuesToMaya(MDataBlock& data, bool isDeformer){
@@ -170,99 +512,286 @@ void FabricSpliceBaseInterface::transferOutputValuesToMaya(MDataBlock& data, boo
   managePortObjectValues(false); // recreate objects if not there yet
 
   FabricSplice::Logging::AutoTimer timer("Maya::transferOutputValuesToMaya()");
-  
+
+  if(_portBindingsDirty)
+    rebuildPortBindings();
+
+  MObject thisMObject = getThisMObject();
+
+  for(size_t i = 0; i < _portBindings.size(); ++i){
+    PortBinding & binding = _portBindings[i];
+    if(binding.portMode == FabricSplice::Port_Mode_IN)
+      continue;
+
+    MPlug plug(thisMObject, binding.attribute);
+    if(isDeformer && binding.dataType == "PolygonMesh") {
+      data.setClean(plug);
+    } else if(binding.portToPlug != NULL) {
+      if(outputValueChanged(binding)){
+        FabricSplice::Logging::AutoTimer timer("Maya::transferOutputValuesToMaya::conversionFunc()");
+        if(binding.cachedPortToPlug != NULL)
+          (*binding.cachedPortToPlug)(binding.port, plug, data, &binding.conversionCache);
+        else
+          (*binding.portToPlug)(binding.port, plug, data);
+      }
+      data.setClean(plug);
+    }
+  }
+}
+
+bool FabricSpliceBaseInterface::transferOutputValueToMaya(const MPlug &plug, MDataBlock& data){
+  if(_isTransferingInputs)
+    return false;
+
+  if(_portBindingsDirty)
+    rebuildPortBindings();
+
+  int index = getPortBindingIndex(plug);
+  if(index < 0)
+    return false;
+
+  PortBinding & binding = _portBindings[index];
+  if(binding.portMode == FabricSplice::Port_Mode_IN)
+    return false;
+  if(binding.portToPlug == NULL)
+    return false;
+
+  managePortObjectValues(false); // recreate objects if not there yet
+
+  FabricSplice::Logging::AutoTimer timer("Maya::transferOutputValueToMaya()");
+
+  MPlug portPlug(getThisMObject(), binding.attribute);
+  if(outputValueChanged(binding))
+  {
+    if(binding.cachedPortToPlug != NULL)
+      (*binding.cachedPortToPlug)(binding.port, portPlug, data, &binding.conversionCache);
+    else
+      (*binding.portToPlug)(binding.port, portPlug, data);
+  }
+  data.setClean(portPlug);
+  if(plug != portPlug)
+    data.setClean(plug);
+  return true;
+}
+
+void FabricSpliceBaseInterface::rebuildPortBindings(){
+  FabricSplice::Logging::AutoTimer timer("Maya::rebuildPortBindings()");
+
+  _portBindings.clear();
+  _portBindingIndices.clear();
+  _portBindingAttributeIndices.clear();
+  _portBindingHashCollision = false;
+  _portBindingsDirty = false;
+  _dirtyPortBindingFlags.clear();
+  _dirtyPortBindings.clear();
+  _hasPersistedOutputs = false;
+
+  if(!_spliceGraph.isValid())
+    return;
+
+  updatePersistedOutputs();
+
   MFnDependencyNode thisNode(getThisMObject());
 
-  for(int i = 0; i < _spliceGraph.getDGPortCount(); ++i){
-    FabricSplice::DGPort port = _spliceGraph.getDGPort((unsigned int)i);
+  for(unsigned int i = 0; i < _spliceGraph.getDGPortCount(); ++i){
+    FabricSplice::DGPort port = _spliceGraph.getDGPort(i);
     if(!port.isValid())
       continue;
-    int portMode = (int)port.getMode();
-    if(portMode != (int)FabricSplice::Port_Mode_IN){
-      
-      std::string portName = port.getName();
-      std::string portDataType = port.getDataType();
 
-      MPlug plug = thisNode.findPlug(portName.c_str());
-      if(!plug.isNull()){
-        for(size_t i=0;i<mSpliceMayaDataOverride.size();i++)
-        {
-          if(mSpliceMayaDataOverride[i] == portName)
-          {
-            portDataType = "SpliceMayaData";
-            break;
-          }
-        }
+    std::string portName = port.getName();
+    MPlug plug = thisNode.findPlug(portName.c_str());
+    if(plug.isNull())
+      continue;
 
-        if(isDeformer && portDataType == "PolygonMesh") {
-          data.setClean(plug);
-        } else {
-          SplicePortToPlugFunc func = getSplicePortToPlugFunc(portDataType, &port);
-          if(func != NULL) {
-            FabricSplice::Logging::AutoTimer timer("Maya::transferOutputValuesToMaya::conversionFunc()");
-            (*func)(port, plug, data);
-            data.setClean(plug);
-          }
-        }
+    PortBinding binding;
+    binding.portName = portName;
+    binding.dataType = port.getDataType();
+    binding.attribute = plug.attribute();
+    binding.port = port;
+    binding.portMode = port.getMode();
+
+    for(size_t j=0;j<mSpliceMayaDataOverride.size();j++)
+    {
+      if(mSpliceMayaDataOverride[j] == portName)
+      {
+        binding.dataType = "SpliceMayaData";
+        break;
       }
     }
+
+    binding.plugToPort = NULL;
+    binding.portToPlug = NULL;
+    binding.cachedPlugToPort = NULL;
+    binding.cachedPortToPlug = NULL;
+    if(binding.portMode != FabricSplice::Port_Mode_OUT){
+      binding.plugToPort = getSplicePlugToPortFunc(binding.dataType, &port);
+      binding.cachedPlugToPort = getSpliceCachedPlugToPortFunc(binding.dataType);
+    }
+    if(binding.portMode != FabricSplice::Port_Mode_IN){
+      binding.portToPlug = getSplicePortToPlugFunc(binding.dataType, &port);
+      binding.cachedPortToPlug = getSpliceCachedPortToPlugFunc(binding.dataType);
+    }
+
+    // IO ports might be written by maya, so we only compare pure outputs
+    binding.valueSize = 0;
+    binding.hasLastValue = false;
+    if(binding.portMode == FabricSplice::Port_Mode_OUT)
+      binding.valueSize = getSpliceDataTypePODSize(binding.dataType);
+
+    unsigned int attributeHash = MObjectHandle(binding.attribute).hashCode();
+    if(_portBindingAttributeIndices.find(attributeHash) != _portBindingAttributeIndices.end())
+      _portBindingHashCollision = true;
+    else
+      _portBindingAttributeIndices.insert(std::pair<unsigned int, size_t>(attributeHash, _portBindings.size()));
+
+    _portBindingIndices.insert(std::pair<std::string, size_t>(portName, _portBindings.size()));
+    _portBindings.push_back(binding);
+  }
+
+  // the graph might have been restored with a new context
+  _pendingDirtyInputs.clear();
+  _evalContextDirty = true;
+
+  // the ports or operators might have changed, so the cached outputs are stale
+  if(_prefetcher)
+    _prefetcher->reset();
+  _evaluationCache.clear();
+
+  // the bindings have been reordered, so all inputs need to be transfered again
+  _dirtyPortBindingFlags.resize(_portBindings.size(), 0);
+  _dirtyGeneration++;
+  for(size_t i = 0; i < _portBindings.size(); ++i){
+    if(_portBindings[i].portMode != FabricSplice::Port_Mode_OUT)
+      markPortBindingDirty(i);
   }
 }
 
-void FabricSpliceBaseInterface::collectDirtyPlug(MPlug const &inPlug){
+FabricSpliceBaseInterface::PortBinding * FabricSpliceBaseInterface::getPortBinding(const std::string & portName){
+  std::map<std::string, size_t>::iterator it = _portBindingIndices.find(portName);
+  if(it == _portBindingIndices.end())
+    return NULL;
+  return &_portBindings[it->second];
+}
 
-  FabricSplice::Logging::AutoTimer timer("Maya::collectDirtyPlug()");
+int FabricSpliceBaseInterface::getPortBindingIndex(const MObject & attribute){
+  std::map<unsigned int, size_t>::iterator it = _portBindingAttributeIndices.find(MObjectHandle(attribute).hashCode());
+  if(it != _portBindingAttributeIndices.end() && _portBindings[it->second].attribute == attribute)
+    return (int)it->second;
 
-  MStatus stat;
-  MString name;
+  if(_portBindingHashCollision){
+    for(size_t i = 0; i < _portBindings.size(); ++i){
+      if(_portBindings[i].attribute == attribute)
+        return (int)i;
+    }
+  }
+  return -1;
+}
 
-  MAYASPLICE_CATCH_BEGIN(&stat);
+int FabricSpliceBaseInterface::getPortBindingIndex(const MPlug & plug){
+  // walk up to the plug of the port's attribute
+  MPlug portPlug = plug;
+  while(portPlug.isChild() || portPlug.isElement()){
+    if(portPlug.isElement())
+      portPlug = portPlug.array();
+    else
+      portPlug = portPlug.parent();
+  }
+  return getPortBindingIndex(portPlug.attribute());
+}
 
-  // notify the context about this
-  FabricCore::RTVal context = _spliceGraph.getEvalContext();
+bool FabricSpliceBaseInterface::outputValueChanged(PortBinding & binding){
+  if(binding.valueSize == 0)
+    return true;
+
+  FabricSplice::Logging::AutoTimer timer("Maya::outputValueChanged()");
 
-  if(inPlug.isElement()){
-    name = inPlug.array().partialName(false, false, false, false, false, true);
+  std::vector<char> value;
+  if(binding.port.isArray()){
+    size_t valuesSize = binding.valueSize * binding.port.getArrayCount();
+    value.resize(valuesSize);
+    if(valuesSize > 0)
+      binding.port.getArrayData(&value[0], valuesSize);
   }
   else{
-    name = inPlug.partialName(false, false, false, false, false, true);
+    FabricCore::RTVal rtVal = binding.port.getRTVal();
+    const char * rtData = (const char *)rtVal.getData();
+    if(rtData == NULL)
+      return true;
+    value.assign(rtData, rtData + binding.valueSize);
   }
 
-  std::vector<FabricCore::RTVal> args(1);
-  args[0] = FabricSplice::constructStringRTVal(name.asChar());
-  if(inPlug.isElement()){
-    args.push_back(FabricSplice::constructSInt32RTVal(inPlug.logicalIndex()));
+  if(binding.hasLastValue && value.size() == binding.lastValue.size()){
+    if(value.size() == 0 || memcmp(&value[0], &binding.lastValue[0], value.size()) == 0)
+      return false;
   }
-  MStringArray splitBuffer;
-  name.split('.', splitBuffer);
 
-  MString portName = splitBuffer[0];
-  FabricSplice::DGPort port = _spliceGraph.getDGPort(portName.asChar());
-  if(port.isValid()){
-    if(port.getMode() != FabricSplice::Port_Mode_OUT)
-      context.callMethod("", "_addDirtyInput", args.size(), &args[0]);
-  }
+  binding.lastValue.swap(value);
+  binding.hasLastValue = true;
+  return true;
+}
 
-  MAYASPLICE_CATCH_END(&stat);
+void FabricSpliceBaseInterface::markPortBindingDirty(size_t index){
+  if(_dirtyPortBindingFlags[index])
+    return;
+  _dirtyPortBindingFlags[index] = 1;
+  _dirtyPortBindings.push_back(index);
+}
 
-  if(inPlug.isChild()){
-    // if plug belongs to translation or rotation we collect the parent to transfer all x,y,z values
-    if(inPlug.parent().isElement()){
-      collectDirtyPlug(inPlug.parent().array());
-      return;
+void FabricSpliceBaseInterface::collectDirtyPlug(MPlug const &inPlug){
+
+  FabricSplice::Logging::AutoTimer timer("Maya::collectDirtyPlug()");
+
+  // don't touch the bindings while another thread evaluates the node
+  EvaluationScope scope(this);
+
+  MStatus stat;
+
+  MAYASPLICE_CATCH_BEGIN(&stat);
+
+  if(_portBindingsDirty)
+    rebuildPortBindings();
+
+  // walk up to the plug of the port's attribute. if plug belongs to
+  // translation or rotation we collect the parent to transfer all x,y,z values
+  MPlug portPlug = inPlug;
+  int elementIndex = -1;
+  while(portPlug.isChild() || portPlug.isElement()){
+    if(portPlug.isElement()){
+      elementIndex = portPlug.logicalIndex();
+      portPlug = portPlug.array();
     }
     else{
-      collectDirtyPlug(inPlug.parent());
-      return;
+      elementIndex = -1;
+      portPlug = portPlug.parent();
     }
   }
 
-  for(int i = 0; i < _dirtyPlugs.length(); ++i){
-    if(_dirtyPlugs[i] == name)
-      return;
+  int index = getPortBindingIndex(portPlug.attribute());
+  if(index < 0){
+    // not a port (evalID, time etc), but it still affects the outputs
+    _dirtyGeneration++;
+    return;
   }
 
-  _dirtyPlugs.append(name);
+  PortBinding & binding = _portBindings[index];
+  if(binding.portMode == FabricSplice::Port_Mode_OUT)
+    return;
+
+  _dirtyGeneration++;
+
+  // the prefetched frames assumed the current values of all inputs
+  // which aren't evaluated per frame
+  if(_prefetcher && !_prefetcher->isTimeDriven(binding.portName))
+    _prefetcher->cancel();
+
+  // the context is notified about this right before the next evaluation
+  if(!inPlug.isElement())
+    elementIndex = -1;
+  _pendingDirtyInputs.insert(std::pair<size_t, int>(index, elementIndex));
+
+  markPortBindingDirty(index);
+
+  MAYASPLICE_CATCH_END(&stat);
 }
 
 void FabricSpliceBaseInterface::affectChildPlugs(MPlug &plug, MPlugArray &affectedPlugs){
@@ -754,10 +1283,19 @@ void FabricSpliceBaseInterface::addMayaAttribute(const MString &portName, const
       pAttr.setStorable(true);
     }
 
+    // the values wrapped by SpliceMayaData are only written to the file
+    // on request, for values which are expensive to recompute
+    if(dataTypeOverride == "SpliceMayaData"){
+      FabricSplice::DGPort port = _spliceGraph.getDGPort(portName.asChar());
+      bool storeData = port.hasOption("storeSpliceMayaData") && port.getOption("storeSpliceMayaData").getBoolean();
+      tAttr.setStorable(storeData);
+    }
+
     thisNode.addAttribute(newAttribute);
   }
 
   setupMayaAttributeAffects(portName, portMode, newAttribute);
+  rebuildPortBindings();
 
   MAYASPLICE_CATCH_END(stat);
 }
@@ -821,6 +1359,8 @@ void FabricSpliceBaseInterface::addPort(const MString &portName, const MString &
 
   _spliceGraph.addDGNodeMember(portName.asChar(), dataType.asChar(), defaultValue, dgNode.asChar(), extension.asChar());
   _spliceGraph.addDGPort(portName.asChar(), portName.asChar(), portMode, dgNode.asChar(), autoInitObjects);
+  _portBindingsDirty = true;
+  _persistenceGeneration++;
 
   MAYASPLICE_CATCH_END(stat);
 }
@@ -833,6 +1373,8 @@ void FabricSpliceBaseInterface::removeMayaAttribute(const MString &portName, MSt
   MPlug plug = thisNode.findPlug(portName);
   if(!plug.isNull())
     thisNode.removeAttribute(plug.attribute());
+  _portBindingsDirty = true;
+  _persistenceGeneration++;
 
   MAYASPLICE_CATCH_END(stat);
 }
@@ -842,6 +1384,9 @@ void FabricSpliceBaseInterface::removePort(const MString &portName, MStatus *sta
 
   FabricSplice::DGPort port = _spliceGraph.getDGPort(portName.asChar());
   _spliceGraph.removeDGNodeMember(portName.asChar(), port.getDGNodeName());
+  _persistedPorts.erase(portName.asChar());
+  _portBindingsDirty = true;
+  _persistenceGeneration++;
 
   MAYASPLICE_CATCH_END(stat);
 }
@@ -852,6 +1397,7 @@ void FabricSpliceBaseInterface::addKLOperator(const MString &operatorName, const
   FabricSplice::Logging::AutoTimer timer("Maya::addKLOperator()");
 
   _spliceGraph.constructKLOperator(operatorName.asChar(), operatorCode.asChar(), operatorEntry.asChar(), dgNode.asChar(), portMap);
+  _persistenceGeneration++;
   invalidateNode();
 
   MAYASPLICE_CATCH_END(stat);
@@ -863,6 +1409,7 @@ void FabricSpliceBaseInterface::setKLOperatorEntry(const MString &operatorName,
   FabricSplice::Logging::AutoTimer timer("Maya::setKLOperatorEntry()");
 
   _spliceGraph.setKLOperatorEntry(operatorName.asChar(), operatorEntry.asChar());
+  _persistenceGeneration++;
   invalidateNode();
 
   MAYASPLICE_CATCH_END(stat);
@@ -875,6 +1422,7 @@ void FabricSpliceBaseInterface::setKLOperatorIndex(const MString &operatorName,
   FabricSplice::Logging::AutoTimer timer("Maya::setKLOperatorIndex()");
 
   _spliceGraph.setKLOperatorIndex(operatorName.asChar(), operatorIndex);
+  _persistenceGeneration++;
   invalidateNode();
 
   MAYASPLICE_CATCH_END(stat);
@@ -886,6 +1434,7 @@ void FabricSpliceBaseInterface::setKLOperatorCode(const MString &operatorName, c
   FabricSplice::Logging::AutoTimer timer("Maya::setKLOperatorCode()");
 
   _spliceGraph.setKLOperatorSourceCode(operatorName.asChar(), operatorCode.asChar(), operatorEntry.asChar());
+  _persistenceGeneration++;
   invalidateNode();
 
   MAYASPLICE_CATCH_END(stat);
@@ -906,6 +1455,7 @@ void FabricSpliceBaseInterface::setKLOperatorFile(const MString &operatorName, c
   FabricSplice::Logging::AutoTimer timer("Maya::setKLOperatorFile()");
 
   _spliceGraph.setKLOperatorFilePath(operatorName.asChar(), filename.asChar(), entry.asChar());
+  _persistenceGeneration++;
   invalidateNode();
 
   MAYASPLICE_CATCH_END(stat);
@@ -917,17 +1467,49 @@ void FabricSpliceBaseInterface::removeKLOperator(const MString &operatorName, co
   FabricSplice::Logging::AutoTimer timer("Maya::removeKLOperator()");
 
   _spliceGraph.removeKLOperator(operatorName.asChar(), dgNode.asChar());
+  _persistenceGeneration++;
   invalidateNode();
 
   MAYASPLICE_CATCH_END(stat);
 }
 
 void FabricSpliceBaseInterface::storePersistenceData(MString file, MStatus *stat){
+  if(!requiresStorePersistenceData(file))
+    return;
+
   MAYASPLICE_CATCH_BEGIN(stat);
 
   FabricSplice::Logging::AutoTimer timer("Maya::storePersistenceData()");
 
-  MPlug saveDataPlug = getSaveDataPlug();
+  unsigned int generation = _persistenceGeneration;
+  writePersistenceData(encodePersistenceData(file), generation, file);
+
+  MAYASPLICE_CATCH_END(stat);
+}
+
+static std::string getFileDirectory(const MString & file)
+{
+  std::string path = file.asChar();
+  size_t separator = path.find_last_of("/\\");
+  if(separator == std::string::npos)
+    return std::string();
+  return path.substr(0, separator);
+}
+
+// whether the graph changed since its persistence data was last written or
+// restored, or the data is written next to a scene in another directory
+bool FabricSpliceBaseInterface::requiresStorePersistenceData(const MString & file) const{
+  // the saveData of a deferred node still holds its graph
+  if(_restoreDeferred)
+    return false;
+  if(!_hasStoredPersistenceData || _storedPersistenceGeneration != _persistenceGeneration)
+    return true;
+  return _storedPersistenceDirectory != getFileDirectory(file);
+}
+
+// only reads the node's own graph, so nodes can be encoded on worker threads.
+MString FabricSpliceBaseInterface::encodePersistenceData(const MString & file){
+  FabricSplice::Logging::AutoTimer timer("Maya::encodePersistenceData()");
 
   FabricSplice::PersistenceInfo info;
   info.hostAppName = FabricCore::Variant::CreateString("Maya");
@@ -936,9 +1518,15 @@ void FabricSpliceBaseInterface::storePersistenceData(MString file, MStatus *stat
 
   FabricCore::Variant dictData = _spliceGraph.getPersistenceDataDict(&info);
   
-  saveDataPlug.setString(dictData.getJSONEncoding().getStringData());
+  bool binary = !FabricSplicePersistenceData::isJSONRequested();
+  return FabricSplicePersistenceData::encode(dictData, binary);
+}
 
-  MAYASPLICE_CATCH_END(stat);
+void FabricSpliceBaseInterface::writePersistenceData(const MString & encoded, unsigned int generation, const MString & file){
+  getSaveDataPlug().setString(encoded);
+  _storedPersistenceGeneration = generation;
+  _hasStoredPersistenceData = true;
+  _storedPersistenceDirectory = getFileDirectory(file);
 }
 
 void FabricSpliceBaseInterface::restoreFromPersistenceData(MString file, MStatus *stat){
@@ -949,14 +1537,48 @@ void FabricSpliceBaseInterface::restoreFromPersistenceData(MString file, MStatus
 
   FabricSplice::Logging::AutoTimer timer("Maya::restoreFromPersistenceData()");
 
+  FabricSplicePersistenceData persistenceData;
+  FabricCore::Variant dictData;
+  if(!persistenceData.parse(getSaveData()) || !persistenceData.getDict(dictData)){
+    MFnDependencyNode thisNode(getThisMObject());
+    mayaLogErrorFunc("Corrupt persistence data on "+thisNode.name()+".");
+    if(stat)
+      *stat = MS::kFailure;
+  }
+  else{
+    restoreGraphFromPersistenceData(file, dictData);
+    finishRestoreFromPersistenceData();
+  }
+
+  MAYASPLICE_CATCH_END(stat);
+}
+
+// the persisted members carry their value in the persistence data
+static void gatherPersistedPorts(const FabricCore::Variant & data, std::set<std::string> & ports)
+{
+  if(data.isDict()){
+    const FabricCore::Variant * name = data.getDictValue("name");
+    if(name != NULL && name->isString() && data.getDictValue("value") != NULL)
+      ports.insert(name->getStringData());
+    for(FabricCore::Variant::DictIter keyIter(data); !keyIter.isDone(); keyIter.next())
+      gatherPersistedPorts(*keyIter.getValue(), ports);
+  }
+  else if(data.isArray()){
+    for(uint32_t i = 0; i < data.getArraySize(); ++i)
+      gatherPersistedPorts(*data.getArrayElement(i), ports);
+  }
+}
+
+// only touches the node's own graph, so nodes can be restored on worker
+// threads. compiles the operators, throws on errors.
+bool FabricSpliceBaseInterface::restoreGraphFromPersistenceData(const MString & file, const FabricCore::Variant & dictData){
+  FabricSplice::Logging::AutoTimer timer("Maya::restoreGraphFromPersistenceData()");
+
   FabricSplice::PersistenceInfo info;
   info.hostAppName = FabricCore::Variant::CreateString("Maya");
   info.hostAppVersion = FabricCore::Variant::CreateString(MGlobal::mayaVersion().asChar());
   info.filePath = FabricCore::Variant::CreateString(file.asChar());
 
-  MPlug saveDataPlug = getSaveDataPlug();
-
-  FabricCore::Variant dictData = FabricCore::Variant::CreateFromJSON(saveDataPlug.asString().asChar());
   bool dataRestored = _spliceGraph.setFromPersistenceDataDict(dictData, &info);
 
   if(dataRestored){
@@ -967,8 +1589,69 @@ void FabricSpliceBaseInterface::restoreFromPersistenceData(MString file, MStatus
     // }
   }
 
+  _persistedPorts.clear();
+  gatherPersistedPorts(dictData, _persistedPorts);
+
+  // the saveData holds the restored graph until it is edited
+  _storedPersistenceGeneration = _persistenceGeneration;
+  _hasStoredPersistenceData = true;
+  _storedPersistenceDirectory = getFileDirectory(file);
+
   _restoredFromPersistenceData = true;
+  _restoreDeferred = false;
+  return dataRestored;
+}
+
+// keeps the raw persistence data, the graph is restored once the node
+// is first evaluated or inspected.
+void FabricSpliceBaseInterface::deferRestoreFromPersistenceData(const MString & file){
+  if(_restoredFromPersistenceData || _restoreDeferred)
+    return;
+
+  _deferredSaveData = getSaveData();
+  _deferredRestoreFile = file;
+  _restoreDeferred = true;
+}
+
+// when evaluating, the node might be computed on a worker thread and
+// its outputs are computed anyway, so the node is not dirtied.
+void FabricSpliceBaseInterface::restoreDeferredPersistenceData(bool evaluating, MStatus *stat){
+  if(!_restoreDeferred)
+    return;
+  _restoreDeferred = false;
+
+  MAYASPLICE_CATCH_BEGIN(stat);
+
+  FabricSplice::Logging::AutoTimer timer("Maya::restoreDeferredPersistenceData()");
+
+  FabricSplicePersistenceData persistenceData;
+  FabricCore::Variant dictData;
+  bool valid = persistenceData.parse(_deferredSaveData) && persistenceData.getDict(dictData);
+  _deferredSaveData.clear();
+
+  if(!valid){
+    MFnDependencyNode thisNode(getThisMObject());
+    mayaLogErrorFunc("Corrupt persistence data on "+thisNode.name()+".");
+    if(stat)
+      *stat = MS::kFailure;
+  }
+  else{
+    restoreGraphFromPersistenceData(_deferredRestoreFile, dictData);
+    if(evaluating){
+      bool dgDirtyEnabled = _dgDirtyEnabled;
+      _dgDirtyEnabled = false;
+      invalidateNode();
+      _dgDirtyEnabled = dgDirtyEnabled;
+    }
+    else
+      finishRestoreFromPersistenceData();
+  }
 
+  MAYASPLICE_CATCH_END(stat);
+}
+
+// binds the restored graph to the maya node, on the main thread.
+void FabricSpliceBaseInterface::finishRestoreFromPersistenceData(){
   invalidateNode();
 
   MFnDependencyNode thisNode(getThisMObject());
@@ -993,8 +1676,6 @@ void FabricSpliceBaseInterface::restoreFromPersistenceData(MString file, MStatus
       break;
     }
   }
-
-  MAYASPLICE_CATCH_END(stat);
 }
 
 void FabricSpliceBaseInterface::resetInternalData(MStatus *stat){
@@ -1003,6 +1684,9 @@ void FabricSpliceBaseInterface::resetInternalData(MStatus *stat){
   FabricSplice::Logging::AutoTimer timer("Maya::resetInternalData()");
 
   _spliceGraph.clear();
+  _persistedPorts.clear();
+  _portBindingsDirty = true;
+  _persistenceGeneration++;
 
   MAYASPLICE_CATCH_END(stat);
 }
@@ -1011,30 +1695,12 @@ void FabricSpliceBaseInterface::invalidatePlug(MPlug & plug)
 {
   if(!_dgDirtyEnabled)
     return;
-  if(plug.isNull())
-    return;
-  if(plug.attribute().isNull())
-    return;
-
-  MString command("dgdirty ");
-
-  // filter plugs containing [-1]
-  MString plugName = plug.name();
-  MStringArray plugNameParts;
-  plugName.split('[', plugNameParts);
-  if(plugNameParts.length() > 1)
-  {
-    if(plugNameParts[1].substring(0, 2) == "-1]")
-      return;
-  }
 
-  MGlobal::executeCommandOnIdle(command+plugName);
+  FabricSpliceInvalidationQueue::add(plug);
 }
 
 void FabricSpliceBaseInterface::invalidateNode()
 {
-  if(!_dgDirtyEnabled)
-    return;
   FabricSplice::Logging::AutoTimer timer("Maya::invalidateNode()");
 
   MFnDependencyNode thisNode(getThisMObject());
@@ -1059,6 +1725,13 @@ void FabricSpliceBaseInterface::invalidateNode()
     }
   }
 
+  // the ports might have changed, bind them again
+  rebuildPortBindings();
+  _dirtyGeneration++;
+
+  if(!_dgDirtyEnabled)
+    return;
+
   // ensure that the node is invalidated
   for(int i = 0; i < _spliceGraph.getDGPortCount(); ++i){
     std::string portName = _spliceGraph.getDGPortName(i);
@@ -1082,12 +1755,8 @@ void FabricSpliceBaseInterface::invalidateNode()
       }
       else
       {
+        // the children and elements are dirtied along with the plug
         invalidatePlug(plug);
-
-        MPlugArray plugs;
-        affectChildPlugs(plug, plugs);
-        for(int j=0;j<plugs.length();j++)
-          invalidatePlug(plugs[j]);
       }
     }
   }
@@ -1241,6 +1910,14 @@ MStatus FabricSpliceBaseInterface::loadFromFile(MString fileName)
     }
   }
 
+  // the values persisted in the file aren't known, assume all outputs are
+  _persistedPorts.clear();
+  for(unsigned int i = 0; i < _spliceGraph.getDGPortCount(); ++i){
+    FabricSplice::DGPort port = _spliceGraph.getDGPort(i);
+    if(port.isValid() && port.getMode() != FabricSplice::Port_Mode_IN)
+      _persistedPorts.insert(port.getName());
+  }
+  _persistenceGeneration++;
   invalidateNode();
 
   MAYASPLICE_CATCH_END(&loadStatus);
@@ -1286,21 +1963,47 @@ void FabricSpliceBaseInterface::setDependentsDirty(MObject thisMObject, MPlug co
 
 void FabricSpliceBaseInterface::copyInternalData(MPxNode *node){
   FabricSpliceBaseInterface *otherSpliceInterface = getInstanceByName(node->name().asChar());
+  otherSpliceInterface->restoreDeferredPersistenceData();
 
   std::string jsonData = otherSpliceInterface->_spliceGraph.getPersistenceDataJSON();
   _spliceGraph.setFromPersistenceDataJSON(jsonData.c_str());
+  _persistedPorts = otherSpliceInterface->_persistedPorts;
+  _portBindingsDirty = true;
+  _persistenceGeneration++;
 }
 
 void FabricSpliceBaseInterface::setPortPersistence(const MString &portName, bool persistence){
   _spliceGraph.setMemberPersistence(portName.asChar(), persistence);
+  if(persistence)
+    _persistedPorts.insert(portName.asChar());
+  else
+    _persistedPorts.erase(portName.asChar());
+  updatePersistedOutputs();
+  _persistenceGeneration++;
+}
+
+void FabricSpliceBaseInterface::updatePersistedOutputs(){
+  _hasPersistedOutputs = false;
+  for(std::set<std::string>::iterator it = _persistedPorts.begin(); it != _persistedPorts.end(); ++it){
+    FabricSplice::DGPort port = _spliceGraph.getDGPort(it->c_str());
+    if(port.isValid() && port.getMode() != FabricSplice::Port_Mode_IN){
+      _hasPersistedOutputs = true;
+      break;
+    }
+  }
 }
 
 void FabricSpliceBaseInterface::onNodeAdded(MObject &node, void *clientData)
 {
-  MFnDependencyNode thisNode(node);
-  FabricSpliceBaseInterface * interf = getInstanceByName(thisNode.name().asChar());
-  if(interf)
-    interf->managePortObjectValues(false); // reattach
+  FabricSpliceBaseInterface * interf = getInstanceByObject(node);
+  if(!interf)
+    return;
+  interf->managePortObjectValues(false); // reattach
+
+  _instancesLock.lock();
+  if(_gatherAddedInstancesDepth > 0)
+    _addedInstances.push_back(interf);
+  _instancesLock.unlock();
 }
 
 void FabricSpliceBaseInterface::onNodeRemoved(MObject &node, void *clientData)
@@ -3,9 +3,13 @@
 #define _FabricSpliceBaseInterface_H_
 
 #include "FabricSpliceConversion.h"
+#include "FabricSpliceEvaluationCache.h"
+#include "FabricSplicePrefetcher.h"
 #include "plugin.h"
 
 #include <vector>
+#include <map>
+#include <set>
 
 #include <maya/MFnDependencyNode.h> 
 #include <maya/MPlug.h> 
@@ -14,6 +18,11 @@
 #include <maya/MNodeMessage.h>
 #include <maya/MStringArray.h>
 #include <maya/MFnCompoundAttribute.h>
+#include <maya/MSpinLock.h>
+#include <maya/MMutexLock.h>
+#if _SPLICE_MAYA_VERSION >= 2016
+#include <maya/MEvaluationNode.h>
+#endif
 
 #include <FabricSplice.h>
 
@@ -47,6 +56,17 @@ public:
 
   static std::vector<FabricSpliceBaseInterface*> getInstances();
   static FabricSpliceBaseInterface * getInstanceByName(const std::string & name);
+  static FabricSpliceBaseInterface * getInstanceByObject(const MObject & node);
+
+  // collects the nodes added while importing or referencing a file,
+  // nested references are gathered along with the outermost file.
+  static void beginGatherAddedInstances();
+  static std::vector<FabricSpliceBaseInterface*> endGatherAddedInstances();
+  static void clearAddedInstances();
+
+  // drops the state of the conversions, such as the uploaded meshes of
+  // PolygonMesh inputs, needs to be called before the client is destroyed
+  static void clearConversionCaches();
 
   void addMayaAttribute(const MString &portName, const MString &dataType, const MString &arrayType, const FabricSplice::Port_Mode &portMode, MStatus *stat = 0);
   void addPort(const MString &portName, const MString &dataType, const FabricSplice::Port_Mode &portMode, const MString & dgNode, bool autoInitObjects, const MString & extension, const FabricCore::Variant & defaultValue, MStatus *stat = 0);
@@ -60,7 +80,19 @@ public:
   void setKLOperatorFile(const MString &operatorName, const MString &filename, const MString &entry, MStatus *stat = 0);
   void removeKLOperator(const MString &operatorName, const MString & dgNode, MStatus *stat = 0);
   void storePersistenceData(MString file, MStatus *stat = 0);
+  bool requiresStorePersistenceData(const MString & file) const;
+  MString encodePersistenceData(const MString & file);
+  void writePersistenceData(const MString & encoded, unsigned int generation, const MString & file);
+  unsigned int getPersistenceGeneration() const { return _persistenceGeneration; }
+  void markPersistenceDataDirty() { _persistenceGeneration++; }
   void restoreFromPersistenceData(MString file, MStatus *stat = 0);
+  bool restoreGraphFromPersistenceData(const MString & file, const FabricCore::Variant & dictData);
+  void finishRestoreFromPersistenceData();
+  bool isRestoredFromPersistenceData() const { return _restoredFromPersistenceData; }
+  void deferRestoreFromPersistenceData(const MString & file);
+  void restoreDeferredPersistenceData(bool evaluating = false, MStatus *stat = 0);
+  bool isRestoreDeferred() const { return _restoreDeferred; }
+  MString getSaveData() { return getSaveDataPlug().asString(); }
   void resetInternalData(MStatus *stat = 0);
   MStringArray getKLOperatorNames();
   MStringArray getPortNames();
@@ -70,8 +102,14 @@ public:
   void setPortPersistence(const MString &portName, bool persistence);
   FabricSplice::DGGraph & getSpliceGraph() { return _spliceGraph; }
   void setDgDirtyEnabled(bool enabled) { _dgDirtyEnabled = enabled; }
+  FabricSpliceEvaluationCache & getEvaluationCache() { return _evaluationCache; }
+  MStringArray evaluateSamples(const std::vector<MTime> & times, MStatus *stat = 0);
+  void setPrefetchFrames(unsigned int frames);
+  unsigned int getPrefetchFrames() const;
+  unsigned int getPrefetchedCount() const;
 
   static void onNodeAdded(MObject &node, void *clientData);
+  static void onNodeNameChanged(MObject &node, const MString &prevName, void *clientData);
   static void onNodeRemoved(MObject &node, void *clientData);
 
   void managePortObjectValues(bool destroy);
@@ -82,20 +120,124 @@ protected:
   void incEvalID();
   void setupMayaAttributeAffects(MString portName, FabricSplice::Port_Mode portMode, MObject newAttribute, MStatus *stat = 0);
 
+  // prebound conversion information for a single port, resolved once
+  // when the ports change so that compute doesn't have to look up
+  // plugs, ports and conversion functions by name.
+  struct PortBinding {
+    std::string portName;
+    std::string dataType;
+    MObject attribute;
+    FabricSplice::DGPort port;
+    FabricSplice::Port_Mode portMode;
+    SplicePlugToPortFunc plugToPort;
+    SplicePortToPlugFunc portToPlug;
+    SpliceCachedPlugToPortFunc cachedPlugToPort;
+    SpliceCachedPortToPlugFunc cachedPortToPlug;
+    SpliceConversionCache conversionCache;
+    FabricCore::RTVal nameRTVal;
+    // raw data of the last transfered output value, used to skip
+    // conversions of unchanged outputs. valueSize is 0 for types
+    // which can't be compared by their memory (objects, strings).
+    size_t valueSize;
+    bool hasLastValue;
+    std::vector<char> lastValue;
+  };
+  void rebuildPortBindings();
+  PortBinding * getPortBinding(const std::string & portName);
+  int getPortBindingIndex(const MObject & attribute);
+  int getPortBindingIndex(const MPlug & plug);
+  void markPortBindingDirty(size_t index);
+  bool outputValueChanged(PortBinding & binding);
+
+  // the evaluation of a node is serialized across threads, while the
+  // thread holding it may re-enter (pulling inputs which depend on the
+  // node). begin returns false on re-entrance, end must only be called
+  // if begin returned true.
+  bool beginEvaluation();
+  void endEvaluation();
+  class EvaluationScope {
+  public:
+    EvaluationScope(FabricSpliceBaseInterface * node) : _node(node) { _acquired = node->beginEvaluation(); }
+    ~EvaluationScope() { if(_acquired) _node->endEvaluation(); }
+    bool reentered() const { return !_acquired; }
+  private:
+    FabricSpliceBaseInterface * _node;
+    bool _acquired;
+  };
+  MMutexLock _evaluationLock;
+  void * volatile _evaluatingThread;
+
   // private members and helper methods
   static std::vector<FabricSpliceBaseInterface*> _instances;
+  static std::vector<FabricSpliceBaseInterface*> _addedInstances;
+  static int _gatherAddedInstancesDepth;
+  static MSpinLock _instancesLock;
   bool _restoredFromPersistenceData;
+  bool _restoreDeferred;
+  MString _deferredSaveData;
+  MString _deferredRestoreFile;
   unsigned int _dummyValue;
 
   FabricSplice::DGGraph _spliceGraph;
-  MStringArray _dirtyPlugs;
   std::vector<std::string> mSpliceMayaDataOverride;
-  bool _isTransferingInputs;
+  std::vector<PortBinding> _portBindings;
+  std::map<std::string, size_t> _portBindingIndices;
+  std::map<unsigned int, size_t> _portBindingAttributeIndices;
+  bool _portBindingHashCollision;
+  bool _portBindingsDirty;
+  std::vector<char> _dirtyPortBindingFlags;
+  std::vector<size_t> _dirtyPortBindings;
+  unsigned int _dirtyGeneration;
+  unsigned int _evaluatedGeneration;
+#if _SPLICE_MAYA_VERSION >= 2016
+  bool _preEvaluated; // the evaluation manager reports the dirty inputs
+#endif
+  bool _isTransferingInputs; // guarded by the evaluation lock
+  FabricSpliceEvaluationCache _evaluationCache;
+
+  // the members of the evaluation context are only set when they change,
+  // the dirty inputs are handed to the context right before evaluating.
+  void flushDirtyInputs(FabricCore::RTVal & context);
+  bool _evalContextDirty;
+  bool _hasEvalContextTime;
+  double _evalContextTime;
+  MCallbackId _nameChangedCallbackId;
+  std::set< std::pair<size_t, int> > _pendingDirtyInputs;
+
+  // bumped by every change which might affect the persistence data, so
+  // that saving skips the graphs which haven't changed since last written.
+  unsigned int _persistenceGeneration;
+  unsigned int _storedPersistenceGeneration;
+  bool _hasStoredPersistenceData;
+  // the operator files are stored relative to the scene's directory
+  std::string _storedPersistenceDirectory;
+  // the ports whose values are part of the persistence data
+  std::set<std::string> _persistedPorts;
+  bool _hasPersistedOutputs;
+  void updatePersistedOutputs();
+  FabricSplicePrefetcher * _prefetcher;
   bool _portObjectsDestroyed;
 
   void transferInputValuesToSplice(MDataBlock& data);
-  void evaluate();
+  void evaluate(const MTime & time);
+  void evaluateCached(const MTime & time, bool isNormalContext = true);
+  // the time of the context the data block is evaluated for, so that
+  // getAttr -t, motion blur and bake tools evaluate at their time
+  static MTime getEvaluationTime(MDataBlock& data);
+  // forgets the transfered inputs and outputs, after evaluating in a
+  // context other than the normal one
+  void invalidateEvaluation();
+  bool getEvaluationCachePorts(std::vector<FabricSpliceEvaluationCache::Port> & inputs, std::vector<FabricSpliceEvaluationCache::Port> & outputs);
+  bool requiresEvaluation() const { return _evaluatedGeneration != _dirtyGeneration; }
+  // whether maya reported the dirty inputs of this evaluation, through
+  // setDependentsDirty in DG mode or preEvaluation under the evaluation manager
+  bool isDirtyTracked(const MDGContext & context) const;
+#if _SPLICE_MAYA_VERSION >= 2016
+  // the evaluation manager doesn't call setDependentsDirty
+  void preEvaluation(const MDGContext & context, const MEvaluationNode & evaluationNode);
+#endif
   void transferOutputValuesToMaya(MDataBlock& data, bool isDeformer = false);
+  bool transferOutputValueToMaya(const MPlug &plug, MDataBlock& data);
   void collectDirtyPlug(MPlug const &inPlug);
   void affectChildPlugs(MPlug &plug, MPlugArray &affectedPlugs);
   void setDependentsDirty(MObject thisMObject, MPlug const &inPlug, MPlugArray &affectedPlugs);
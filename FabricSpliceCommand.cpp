@@ -16,12 +16,14 @@
 #include <maya/MFnMatrixAttribute.h>
 #include <maya/MFnStringData.h>
 #include <maya/MQtUtil.h>
+#include <maya/MAnimControl.h>
 
 #include <FabricSplice.h>
 
 #include "FabricSpliceBaseInterface.h"
 #include "FabricSpliceEditorCmd.h"
 #include "FabricSpliceRenderCallback.h"
+#include "FabricSplicePersistence.h"
 
 #define kActionFlag "-a"
 #define kActionFlagLong "-action"
@@ -71,10 +73,49 @@ MStatus FabricSpliceCommand::doIt(const MArgList &args)
       return mayaErrorOccured();
     }
     else if(actionStr == "destroyClient"){
+      FabricSpliceBaseInterface::clearConversionCaches();
       bool clientDestroyed = FabricSplice::DestroyClient();
       setResult(clientDestroyed);
       return mayaErrorOccured();
     }
+    else if(actionStr == "setLazyRestore"){
+      bool enabled = FabricSplice::Scripting::consumeBooleanArgument(scriptArgs, "enabled", true, true);
+      mayaSetLazyRestoreEnabled(enabled);
+      setResult(mayaLazyRestoreEnabled());
+      return mayaErrorOccured();
+    }
+    else if(actionStr == "setParallelRestore"){
+      bool enabled = FabricSplice::Scripting::consumeBooleanArgument(scriptArgs, "enabled", true, true);
+      mayaSetParallelRestoreEnabled(enabled);
+      setResult(mayaParallelRestoreEnabled());
+      return mayaErrorOccured();
+    }
+    else if(actionStr == "clearPersistenceCache"){
+      size_t cleared = FabricSplicePersistenceData::clearCache();
+      setResult((int)cleared);
+      return mayaErrorOccured();
+    }
+    else if(actionStr == "getRestoreStats"){
+      std::vector<FabricSpliceBaseInterface*> instances = FabricSpliceBaseInterface::getInstances();
+      int deferred = 0;
+      int restored = 0;
+      for(size_t i = 0; i < instances.size(); ++i){
+        if(instances[i]->isRestoreDeferred())
+          deferred++;
+        else if(instances[i]->isRestoredFromPersistenceData())
+          restored++;
+      }
+      FabricCore::Variant stats = FabricCore::Variant::CreateDict();
+      stats.setDictValue("lazy", FabricCore::Variant::CreateBoolean(mayaLazyRestoreEnabled()));
+      stats.setDictValue("parallel", FabricCore::Variant::CreateBoolean(mayaParallelRestoreEnabled()));
+      stats.setDictValue("deferred", FabricCore::Variant::CreateSInt32(deferred));
+      stats.setDictValue("restored", FabricCore::Variant::CreateSInt32(restored));
+      stats.setDictValue("cachedEntries", FabricCore::Variant::CreateSInt32((int)FabricSplicePersistenceData::getCacheEntryCount()));
+      stats.setDictValue("cachedBytes", FabricCore::Variant::CreateSInt32((int)FabricSplicePersistenceData::getCacheSize()));
+      MString statsStr = stats.getJSONEncoding().getStringData();
+      setResult(statsStr);
+      return mayaErrorOccured();
+    }
     else if(actionStr == "getClientContextID"){
       MString clientContextID = FabricSplice::GetClientContextID();
       setResult(clientContextID);
@@ -101,6 +142,7 @@ MStatus FabricSpliceCommand::doIt(const MArgList &args)
     else if(actionStr == "startProfiling")
     {
       FabricSplice::Logging::enableTimers();
+      setConversionProfiling(true);
       for(unsigned int i=0;i<FabricSplice::Logging::getNbTimers();i++)
       {
         FabricSplice::Logging::resetTimer(FabricSplice::Logging::getTimerName(i));
@@ -114,6 +156,16 @@ MStatus FabricSpliceCommand::doIt(const MArgList &args)
         FabricSplice::Logging::logTimer(FabricSplice::Logging::getTimerName(i));
       }    
       FabricSplice::Logging::disableTimers();
+      setConversionProfiling(false);
+      return mayaErrorOccured();
+    }
+    else if(actionStr == "benchmarkConversionKernels")
+    {
+      MString countStr = FabricSplice::Scripting::consumeStringArgument(scriptArgs, "count", "1000000", true).c_str();
+      MStringArray results = benchmarkConversionKernels((unsigned int)countStr.asInt());
+      for(unsigned int i=0;i<results.length();i++)
+        mayaLogFunc(results[i]);
+      setResult(results);
       return mayaErrorOccured();
     }
 
@@ -124,6 +176,7 @@ MStatus FabricSpliceCommand::doIt(const MArgList &args)
       mayaLogErrorFunc("Splice interface could not be found: '"+referenceStr+"'.");
       return mayaErrorOccured();
     }
+    interf->restoreDeferredPersistenceData();
 
     // find the maya node
     MSelectionList selList;
@@ -226,6 +279,80 @@ MStatus FabricSpliceCommand::doIt(const MArgList &args)
       bool enabled = FabricSplice::Scripting::consumeBooleanArgument(scriptArgs, "enabled");
       interf->setDgDirtyEnabled(enabled);
     }
+    else if(actionStr == "setEvaluationCache")
+    {
+      bool enabled = FabricSplice::Scripting::consumeBooleanArgument(scriptArgs, "enabled");
+      int budget = FabricSplice::Scripting::consumeIntegerArgument(scriptArgs, "budget", 0, true);
+      FabricSpliceEvaluationCache & cache = interf->getEvaluationCache();
+      if(!enabled)
+        interf->setPrefetchFrames(0);
+      cache.setEnabled(enabled);
+      if(budget > 0)
+        cache.setBudget((size_t)budget * 1024 * 1024); // megabytes
+      cache.resetCounters();
+    }
+    else if(actionStr == "setPrefetch")
+    {
+      // prefetching fills the evaluation cache, the budget is shared
+      int frames = FabricSplice::Scripting::consumeIntegerArgument(scriptArgs, "frames");
+      int budget = FabricSplice::Scripting::consumeIntegerArgument(scriptArgs, "budget", 0, true);
+      interf->setPrefetchFrames(frames > 0 ? (unsigned int)frames : 0);
+      if(budget > 0)
+        interf->getEvaluationCache().setBudget((size_t)budget * 1024 * 1024); // megabytes
+    }
+    else if(actionStr == "evaluateSamples")
+    {
+      // samples evenly spread over the shutter, in frames relative to time
+      MString timeStr = FabricSplice::Scripting::consumeStringArgument(scriptArgs, "time", "", true).c_str();
+      int samples = FabricSplice::Scripting::consumeIntegerArgument(scriptArgs, "samples", 1, true);
+      MString shutterOpenStr = FabricSplice::Scripting::consumeStringArgument(scriptArgs, "shutterOpen", "-0.5", true).c_str();
+      MString shutterCloseStr = FabricSplice::Scripting::consumeStringArgument(scriptArgs, "shutterClose", "0.5", true).c_str();
+
+      MTime time = MAnimControl::currentTime();
+      if(timeStr.length() > 0)
+        time = MTime(timeStr.asDouble(), MTime::uiUnit());
+
+      std::vector<MTime> times;
+      if(samples <= 1)
+        times.push_back(time);
+      else
+      {
+        double shutterOpen = shutterOpenStr.asDouble();
+        double shutterClose = shutterCloseStr.asDouble();
+        for(int i=0;i<samples;i++)
+        {
+          double offset = shutterOpen + (shutterClose - shutterOpen) * double(i) / double(samples - 1);
+          times.push_back(time + MTime(offset, MTime::uiUnit()));
+        }
+      }
+
+      MStatus stat;
+      MStringArray results = interf->evaluateSamples(times, &stat);
+      if(stat != MS::kSuccess)
+        return mayaErrorOccured();
+      setResult(results);
+    }
+    else if(actionStr == "clearEvaluationCache")
+    {
+      FabricSpliceEvaluationCache & cache = interf->getEvaluationCache();
+      cache.clear();
+      cache.resetCounters();
+    }
+    else if(actionStr == "getEvaluationCacheStats")
+    {
+      FabricSpliceEvaluationCache & cache = interf->getEvaluationCache();
+      FabricCore::Variant stats = FabricCore::Variant::CreateDict();
+      stats.setDictValue("enabled", FabricCore::Variant::CreateBoolean(cache.isEnabled()));
+      stats.setDictValue("hits", FabricCore::Variant::CreateSInt32(cache.getHits()));
+      stats.setDictValue("misses", FabricCore::Variant::CreateSInt32(cache.getMisses()));
+      stats.setDictValue("entries", FabricCore::Variant::CreateSInt32(cache.getEntryCount()));
+      stats.setDictValue("memory", FabricCore::Variant::CreateFloat64(cache.getMemoryUsage()));
+      stats.setDictValue("budget", FabricCore::Variant::CreateFloat64(cache.getBudget()));
+      stats.setDictValue("prefetchFrames", FabricCore::Variant::CreateSInt32(interf->getPrefetchFrames()));
+      stats.setDictValue("prefetched", FabricCore::Variant::CreateSInt32(interf->getPrefetchedCount()));
+      MString statsStr = stats.getJSONEncoding().getStringData();
+      setResult(statsStr);
+    }
     else if(actionStr == "addDGNode")
     {
       MString dgNodeStr = FabricSplice::Scripting::consumeStringArgument(scriptArgs, "dgNode").c_str();
@@ -452,6 +579,7 @@ MStatus FabricSpliceCommand::doIt(const MArgList &args)
         portDataVar = FabricCore::Variant::CreateFromJSON(auxiliaryStr.asChar());
       port.setVariant(portDataVar);
       interf->setPortPersistence(portNameStr, true);
+      interf->markPersistenceDataDirty();
     }
     // else if(actionStr == "setManipulationCommand"){
     //   MString commandNameStr = FabricSplice::Scripting::consumeStringArgument(scriptArgs, "commandName").c_str();
@@ -1,5 +1,6 @@
 
 #include "FabricSpliceConversion.h"
+#include "FabricSpliceConversionKernels.h"
 #include "FabricSpliceMayaData.h"
 #include "plugin.h"
 
@@ -30,6 +31,9 @@
 #include <maya/MFnNurbsCurveData.h>
 #include <maya/MFloatVectorArray.h>
 #include <maya/MFnAnimCurve.h>
+#include <maya/MTimer.h>
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
 
 #define CORE_CATCH_BEGIN try {
 #define CORE_CATCH_END } \
@@ -785,16 +789,13 @@ void plugToPort_vec3(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port)
   }else{
     MDataHandle handle = data.inputValue(plug);
     if(handle.type() == MFnData::kVectorArray){
+      // the array references the data's values, converted in place
       MVectorArray arrayValues = MFnVectorArrayData(handle.data()).array();
       unsigned int elements = arrayValues.length();
       MAYASPLICE_MEMORY_ALLOCATE(float, elements * 3);
 
-      size_t offset = 0;
-      for(unsigned int i = 0; i < elements; ++i){
-        MAYASPLICE_MEMORY_SETITEM(offset++, (float)arrayValues[i].x);
-        MAYASPLICE_MEMORY_SETITEM(offset++, (float)arrayValues[i].y);
-        MAYASPLICE_MEMORY_SETITEM(offset++, (float)arrayValues[i].z);
-      }
+      if(elements > 0)
+        convertDouble3ToFloat3(&arrayValues[0].x, values, elements);
 
       MAYASPLICE_MEMORY_SETPORT(port);
       MAYASPLICE_MEMORY_FREE();
@@ -803,12 +804,8 @@ void plugToPort_vec3(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port)
       unsigned int elements = arrayValues.length();
       MAYASPLICE_MEMORY_ALLOCATE(float, elements * 3);
 
-      size_t offset = 0;
-      for(unsigned int i = 0; i < elements; ++i){
-        MAYASPLICE_MEMORY_SETITEM(offset++, (float)arrayValues[i].x);
-        MAYASPLICE_MEMORY_SETITEM(offset++, (float)arrayValues[i].y);
-        MAYASPLICE_MEMORY_SETITEM(offset++, (float)arrayValues[i].z);
-      }
+      if(elements > 0)
+        convertDouble4ToFloat3(&arrayValues[0].x, values, elements);
 
       MAYASPLICE_MEMORY_SETPORT(port);
       MAYASPLICE_MEMORY_FREE();
@@ -958,12 +955,51 @@ void plugToPort_mat44(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port
   }
 }
 
-void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port){
+// hashes a buffer as 32 bit words (FNV-1a), used to detect changes
+// of the individual attribute streams of an input mesh.
+uint64_t hashMeshStream(const void * data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+  const uint32_t * words = (const uint32_t *)data;
+  size_t count = size / 4;
+  for(size_t i=0;i<count;i++)
+  {
+    hash ^= words[i];
+    hash *= 1099511628211ULL;
+  }
+  const unsigned char * bytes = (const unsigned char *)data + count * 4;
+  for(size_t i=0;i<size % 4;i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t hashMeshStream(const MString & value, uint64_t hash)
+{
+  return hashMeshStream(value.asChar(), value.length(), hash);
+}
+
+// hashes the elements of a maya array, which can't be indexed while empty
+template<class T>
+uint64_t hashMeshArray(T & values, size_t elementSize, uint64_t hash = 14695981039346656037ULL)
+{
+  if(values.length() == 0)
+    return hash;
+  return hashMeshStream(&values[0], elementSize * values.length(), hash);
+}
+
+void plugToPort_PolygonMesh_cached(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port, SpliceConversionCache * conversionCache){
 
   std::vector<MDataHandle> handles;
   std::vector<FabricCore::RTVal> rtVals;
+  std::vector<PolygonMeshInputCache*> caches;
   FabricCore::RTVal portRTVal;
 
+  // IO ports might get their meshes changed by KL, so we can't rely
+  // on what we uploaded last time.
+  bool useCache = conversionCache != NULL && port.getMode() == FabricSplice::Port_Mode_IN;
+
   try
   {
     if(plug.isArray())
@@ -973,19 +1009,34 @@ void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort
       MArrayDataHandle arrayHandle = data.inputArrayValue(plug);
 
       unsigned int elements = arrayHandle.elementCount();
+      if(useCache)
+        conversionCache->meshInputs.resize(elements);
       for(unsigned int i = 0; i < elements; ++i){
         arrayHandle.jumpToArrayElement(i);
         handles.push_back(arrayHandle.inputValue());
 
+        PolygonMeshInputCache * cache = NULL;
+        if(useCache)
+          cache = &conversionCache->meshInputs[i];
+
         FabricCore::RTVal polygonMesh;
         if(portRTVal.getArraySize() <= i)
         {
-          polygonMesh = FabricSplice::constructObjectRTVal("PolygonMesh");
+          if(cache && cache->polygonMesh.isValid())
+            polygonMesh = cache->polygonMesh;
+          else
+            polygonMesh = FabricSplice::constructObjectRTVal("PolygonMesh");
           portRTVal.callMethod("", "push", 1, &polygonMesh);
         }
         else
         {
-          polygonMesh = portRTVal.getArrayElement(i);
+          if(cache && cache->polygonMesh.isValid())
+          {
+            polygonMesh = cache->polygonMesh;
+            portRTVal.setArrayElement(i, polygonMesh);
+          }
+          else
+            polygonMesh = portRTVal.getArrayElement(i);
           if(!polygonMesh.isValid() || polygonMesh.isNullObject())
           {
             polygonMesh = FabricSplice::constructObjectRTVal("PolygonMesh");
@@ -993,17 +1044,26 @@ void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort
           }
         }
         rtVals.push_back(polygonMesh);
+        caches.push_back(cache);
       }
     }
     else
     {
       handles.push_back(data.inputValue(plug));
 
+      PolygonMeshInputCache * cache = NULL;
+      if(useCache)
+      {
+        conversionCache->meshInputs.resize(1);
+        cache = &conversionCache->meshInputs[0];
+        portRTVal = cache->polygonMesh;
+      }
       if(port.getMode() == FabricSplice::Port_Mode_IO)
         portRTVal = port.getRTVal();
       if(!portRTVal.isValid() || portRTVal.isNullObject())
         portRTVal = FabricSplice::constructObjectRTVal("PolygonMesh");
       rtVals.push_back(portRTVal);
+      caches.push_back(cache);
     }
 
     for(size_t handleIndex=0;handleIndex<handles.size();handleIndex++) 
@@ -1011,9 +1071,30 @@ void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort
       MObject meshObj = handles[handleIndex].asMesh();
       MFnMesh mesh(meshObj);
       FabricCore::RTVal polygonMesh = rtVals[handleIndex];
+      PolygonMeshInputCache * cache = caches[handleIndex];
+
+      // the mesh has been uploaded before if the cache's object is still in use
+      bool cacheValid = cache != NULL && cache->polygonMesh.isValid();
+      if(cache != NULL)
+        cache->polygonMesh = polygonMesh;
+
+      MPointArray mayaPoints;
+      MIntArray mayaCounts, mayaIndices;
+
+      mesh.getPoints(mayaPoints);
+      mesh.getVertices(mayaCounts, mayaIndices);
+
+      // determine if we need a topology update. the fingerprint covers
+      // the indices as well, two meshes sharing their counts would
+      // otherwise be considered the same.
+      uint64_t topologyHash = hashMeshArray(mayaCounts, sizeof(int));
+      topologyHash = hashMeshArray(mayaIndices, sizeof(int), topologyHash);
 
-      // determine if we need a topology update
-      bool requireTopoUpdate = false;
+      bool requireTopoUpdate = !cacheValid;
+      if(cacheValid)
+      {
+        requireTopoUpdate = cache->topologyHash != topologyHash || cache->numVertices != mayaPoints.length();
+      }
       if(!requireTopoUpdate)
       {
         unsigned int nbPolygons = polygonMesh.callMethod("UInt64", "polygonCount", 0, 0).getUInt64();
@@ -1025,55 +1106,61 @@ void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort
         requireTopoUpdate = nbSamples != mesh.numFaceVertices();
       }
 
-      MPointArray mayaPoints;
-      MIntArray mayaCounts, mayaIndices;
-
-      mesh.getPoints(mayaPoints);
-
       if(requireTopoUpdate)
       {
         // clear the mesh
         polygonMesh.callMethod("", "clear", 0, NULL);
       }
 
-      if(mayaPoints.length() > 0)
+      // points-only fast path: skip the upload if nothing moved
+      uint64_t pointsHash = hashMeshArray(mayaPoints, sizeof(double) * 4);
+      bool requirePointsUpdate = requireTopoUpdate || !cacheValid || cache->pointsHash != pointsHash;
+
+      if(mayaPoints.length() > 0 && requirePointsUpdate)
       {
         std::vector<FabricCore::RTVal> args(2);
         args[0] = FabricSplice::constructExternalArrayRTVal("Float64", mayaPoints.length() * 4, &mayaPoints[0]);
         args[1] = FabricSplice::constructUInt32RTVal(4); // components
         polygonMesh.callMethod("", "setPointsFromExternalArray_d", 2, &args[0]);
-        mayaPoints.clear();
       }
+      mayaPoints.clear();
 
-      if(requireTopoUpdate)
+      if(requireTopoUpdate && mayaCounts.length() > 0 && mayaIndices.length() > 0)
       {
-        mesh.getVertices(mayaCounts, mayaIndices);
         std::vector<FabricCore::RTVal> args(2);
         args[0] = FabricSplice::constructExternalArrayRTVal("UInt32", mayaCounts.length(), &mayaCounts[0]);
         args[1] = FabricSplice::constructExternalArrayRTVal("UInt32", mayaIndices.length(), &mayaIndices[0]);
         polygonMesh.callMethod("", "setTopologyFromCountsIndicesExternalArrays", 2, &args[0]);
       }
 
-      MFloatVectorArray mayaNormals;
+      // normals follow the points, but hard edges can change them as well,
+      // and locked normals can be edited without moving any point
       MIntArray mayaNormalsCounts, mayaNormalsIds;
-      mesh.getNormals(mayaNormals);
       mesh.getNormalIds(mayaNormalsCounts, mayaNormalsIds);
+      MFloatVectorArray mayaNormals;
+      mesh.getNormals(mayaNormals);
+      uint64_t normalsHash = hashMeshArray(mayaNormalsIds, sizeof(int));
+      normalsHash = hashMeshArray(mayaNormals, sizeof(float) * 3, normalsHash);
 
-      if(mayaNormals.length() > 0 && mayaNormalsCounts.length() > 0 && mayaNormalsIds.length() > 0)
+      if(requirePointsUpdate || cache->normalsHash != normalsHash)
       {
-        MFloatVectorArray values;
-        values.setLength(mayaNormalsIds.length());
+        if(mayaNormals.length() > 0 && mayaNormalsCounts.length() > 0 && mayaNormalsIds.length() > 0)
+        {
+          MFloatVectorArray values;
+          values.setLength(mayaNormalsIds.length());
 
-        unsigned int offset = 0;
-        for(unsigned int i=0;i<mayaNormalsIds.length();i++)
-          values[offset++] = mayaNormals[mayaNormalsIds[i]];
+          unsigned int offset = 0;
+          for(unsigned int i=0;i<mayaNormalsIds.length();i++)
+            values[offset++] = mayaNormals[mayaNormalsIds[i]];
 
-        std::vector<FabricCore::RTVal> args(1);
-        args[0] = FabricSplice::constructExternalArrayRTVal("Float32", values.length() * 3, &values[0]);
-        polygonMesh.callMethod("", "setNormalsFromExternalArray", 1, &args[0]);
-        values.clear();
+          std::vector<FabricCore::RTVal> args(1);
+          args[0] = FabricSplice::constructExternalArrayRTVal("Float32", values.length() * 3, &values[0]);
+          polygonMesh.callMethod("", "setNormalsFromExternalArray", 1, &args[0]);
+          values.clear();
+        }
       }
 
+      uint64_t uvsHash = 0;
       if(mesh.numUVSets() > 0)
       {
         MFloatArray u, v, values;
@@ -1083,8 +1170,14 @@ void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort
         MIntArray counts, indices;
         mesh.getAssignedUVs(counts, indices);
         counts.clear();
+
+        uvsHash = hashMeshStream(mesh.currentUVSetName(), uvsHash);
+        uvsHash = hashMeshArray(u, sizeof(float), uvsHash);
+        uvsHash = hashMeshArray(v, sizeof(float), uvsHash);
+        uvsHash = hashMeshArray(indices, sizeof(int), uvsHash);
+
         values.setLength(indices.length() * 2);
-        if(values.length() > 0)
+        if(values.length() > 0 && (requireTopoUpdate || cache->uvsHash != uvsHash))
         {
           for(unsigned int i=0;i<indices.length(); i++)
           {
@@ -1102,25 +1195,44 @@ void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort
         }
       }
 
+      uint64_t colorsHash = 0;
       if(mesh.numColorSets() > 0)
       {
-        MColorArray faceValues;
-
         MStringArray colorSetNames;
         mesh.getColorSetNames(colorSetNames);
         MString colorSetName = colorSetNames[0];
 
+        // the per face vertex colors resolve the color ids and their
+        // assignments, so reassigned colors are uploaded as well
+        MColorArray faceValues;
         mesh.getFaceVertexColors(faceValues, &colorSetName);
-        if(faceValues.length() > 0)
+        for(unsigned int i=0;i<colorSetNames.length();i++)
+          colorsHash = hashMeshStream(colorSetNames[i], colorsHash);
+        colorsHash = hashMeshArray(faceValues, sizeof(float) * 4, colorsHash);
+
+        if(requireTopoUpdate || cache->colorsHash != colorsHash)
         {
-          std::vector<FabricCore::RTVal> args(2);
-          args[0] = FabricSplice::constructExternalArrayRTVal("Float32", faceValues.length() * 4, &faceValues[0]);
-          args[1] = FabricSplice::constructUInt32RTVal(4); // components
-          polygonMesh.callMethod("", "setVertexColorsFromExternalArray", 2, &args[0]);
-          faceValues.clear();
+          if(faceValues.length() > 0)
+          {
+            std::vector<FabricCore::RTVal> args(2);
+            args[0] = FabricSplice::constructExternalArrayRTVal("Float32", faceValues.length() * 4, &faceValues[0]);
+            args[1] = FabricSplice::constructUInt32RTVal(4); // components
+            polygonMesh.callMethod("", "setVertexColorsFromExternalArray", 2, &args[0]);
+            faceValues.clear();
+          }
         }
       }
 
+      if(cache != NULL)
+      {
+        cache->numVertices = mesh.numVertices();
+        cache->topologyHash = topologyHash;
+        cache->pointsHash = pointsHash;
+        cache->normalsHash = normalsHash;
+        cache->uvsHash = uvsHash;
+        cache->colorsHash = colorsHash;
+      }
+
       mayaCounts.clear();
       mayaIndices.clear();
     }
@@ -1139,6 +1251,10 @@ void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort
   }
 }
 
+void plugToPort_PolygonMesh(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port){
+  plugToPort_PolygonMesh_cached(plug, data, port, NULL);
+}
+
 void plugToPort_Lines(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port){
 
   std::vector<MDataHandle> handles;
@@ -2294,39 +2410,34 @@ void portToPlug_vec3(FabricSplice::DGPort & port, MPlug &plug, MDataBlock &data)
     if(handle.type() == MFnData::kVectorArray) {
       unsigned int elements = port.getArrayCount();
 
-      MVectorArray arrayValues;
-      arrayValues.setLength(elements);
-
       MAYASPLICE_MEMORY_ALLOCATE(float, elements * 3);
       MAYASPLICE_MEMORY_GETPORT(port);
 
-      size_t offset = 0;
-      for(unsigned int i = 0; i < elements; ++i){
-        arrayValues[i].x = MAYASPLICE_MEMORY_GETITEM(offset++);
-        arrayValues[i].y = MAYASPLICE_MEMORY_GETITEM(offset++);
-        arrayValues[i].z = MAYASPLICE_MEMORY_GETITEM(offset++);
-      }
-
+      // converted straight into the new data's array
+      MFnVectorArrayData arrayData;
+      MObject arrayObject = arrayData.create();
+      MVectorArray arrayValues = arrayData.array();
+      arrayValues.setLength(elements);
+      if(elements > 0)
+        convertFloat3ToDouble3(values, &arrayValues[0].x, elements);
       MAYASPLICE_MEMORY_FREE();
-      handle.set(MFnVectorArrayData().create(arrayValues));
+
+      handle.set(arrayObject);
     }else if(handle.type() == MFnData::kPointArray) {
       unsigned int elements = port.getArrayCount();
 
-      MPointArray arrayValues;
-      arrayValues.setLength(elements);
-
       MAYASPLICE_MEMORY_ALLOCATE(float, elements * 3);
       MAYASPLICE_MEMORY_GETPORT(port);
 
-      size_t offset = 0;
-      for(unsigned int i = 0; i < elements; ++i){
-        arrayValues[i].x = MAYASPLICE_MEMORY_GETITEM(offset++);
-        arrayValues[i].y = MAYASPLICE_MEMORY_GETITEM(offset++);
-        arrayValues[i].z = MAYASPLICE_MEMORY_GETITEM(offset++);
-      }
-
+      MFnPointArrayData arrayData;
+      MObject arrayObject = arrayData.create();
+      MPointArray arrayValues = arrayData.array();
+      arrayValues.setLength(elements);
+      if(elements > 0)
+        convertFloat3ToDouble4(values, &arrayValues[0].x, elements);
       MAYASPLICE_MEMORY_FREE();
-      handle.set(MFnPointArrayData().create(arrayValues));
+
+      handle.set(arrayObject);
     }else{
       FabricCore::RTVal rtVal = port.getRTVal();
       if(handle.numericType() == MFnNumericData::k3Float || handle.numericType() == MFnNumericData::kFloat){
@@ -2447,55 +2558,343 @@ void portToPlug_mat44(FabricSplice::DGPort & port, MPlug &plug, MDataBlock &data
   }
 }
 
-void portToPlug_PolygonMesh_singleMesh(MDataHandle handle, FabricCore::RTVal rtMesh)
+// a range of polygons validated in one go. the blocks are
+// independent of each other, so large meshes run them in parallel.
+struct PolygonMeshTopologyBlock
 {
-  CORE_CATCH_BEGIN;
+  const int * counts;
+  const int * indices;
+  int * sampleFaces;
+  unsigned int firstPolygon;
+  unsigned int endPolygon;
+  unsigned int firstSample;
+  unsigned int nbPoints;
+  bool validate;
+  MString error;
+};
 
-  unsigned int nbPoints = 0;
-  unsigned int nbPolygons = 0;
-  unsigned int nbSamples = 0;
-  if(!rtMesh.isNullObject())
+MThreadRetVal preparePolygonMeshTopologyBlock(void * data)
+{
+  PolygonMeshTopologyBlock * block = (PolygonMeshTopologyBlock*)data;
+  const int * indices = block->indices;
+  unsigned int offset = block->firstSample;
+
+  if(block->validate)
+  {
+    // branchless range check over the whole block first, the offending
+    // point is only searched for if there is one
+    unsigned int endSample = offset;
+    for(unsigned int face=block->firstPolygon;face<block->endPolygon;face++)
+      endSample += block->counts[face];
+
+    unsigned int outOfRange = 0;
+    for(unsigned int i=offset;i<endSample;i++)
+      outOfRange |= (unsigned int)indices[i] >= block->nbPoints;
+    if(outOfRange)
+    {
+      for(unsigned int i=offset;i<endSample;i++)
+      {
+        if((unsigned int)indices[i] >= block->nbPoints)
+        {
+          MString indexStr;
+          indexStr.set(indices[i]);
+          block->error = "Point "+indexStr+" out of range.";
+          return 0;
+        }
+      }
+    }
+  }
+
+  for(unsigned int face=block->firstPolygon;face<block->endPolygon;face++)
   {
-    nbPoints = rtMesh.callMethod("UInt64", "pointCount", 0, 0).getUInt64();
-    nbPolygons = rtMesh.callMethod("UInt64", "polygonCount", 0, 0).getUInt64();
-    nbSamples = rtMesh.callMethod("UInt64", "polygonPointsCount", 0, 0).getUInt64();
+    unsigned int count = block->counts[face];
+    const int * polygon = indices + offset;
+
+    if(block->validate)
+    {
+      // a point may only be used once per polygon. all pairs are compared
+      // for small polygons, larger ones only check their adjacent points.
+      bool corrupt = false;
+      if(count <= 16)
+      {
+        for(unsigned int j=0;j<count && !corrupt;j++)
+          for(unsigned int k=j+1;k<count;k++)
+            corrupt |= polygon[j] == polygon[k];
+      }
+      else
+      {
+        for(unsigned int j=0;j<count;j++)
+          corrupt |= polygon[j] == polygon[(j+1) % count];
+      }
+      if(corrupt)
+      {
+        MString indexStr;
+        indexStr.set((int)face);
+        block->error = "Polygon corrupt polygon ["+indexStr+"].";
+        return 0;
+      }
+    }
+
+    for(unsigned int j=0;j<count;j++)
+      block->sampleFaces[offset+j] = face;
+    offset += count;
   }
+  return 0;
+}
 
-  MPointArray mayaPoints;
-  MVectorArray mayaNormals;
-  MIntArray mayaCounts, mayaIndices;
+void preparePolygonMeshTopologyParallel(void * data, MThreadRootTask * root)
+{
+  std::vector<PolygonMeshTopologyBlock> & blocks = *(std::vector<PolygonMeshTopologyBlock>*)data;
+  for(size_t i=0;i<blocks.size();i++)
+    MThreadPool::createTask(preparePolygonMeshTopologyBlock, &blocks[i], root);
+  MThreadPool::executeAndJoin(root);
+}
+
+// validates counts and indices of a mesh of any polygon sizes in a
+// single pass and fills the face index of each polygon point.
+bool preparePolygonMeshTopology(const MIntArray & counts, const MIntArray & indices, unsigned int nbPoints, MIntArray & sampleFaces, bool validate, MString & error, bool allowParallel = true)
+{
+  const unsigned int polygonsPerBlock = 16384;
+  const unsigned int parallelSamples = 1 << 20;
+
+  unsigned int nbPolygons = counts.length();
+  unsigned int nbSamples = indices.length();
 
-  mayaPoints.setLength(nbPoints);
-  if(mayaPoints.length() > 0)
+  // the counts have to be scanned serially to know where the blocks start
+  std::vector<PolygonMeshTopologyBlock> blocks;
+  unsigned int offset = 0;
+  for(unsigned int face=0;face<nbPolygons;face++)
+  {
+    if(face % polygonsPerBlock == 0)
+    {
+      PolygonMeshTopologyBlock block;
+      block.counts = &counts[0];
+      block.indices = &indices[0];
+      block.sampleFaces = &sampleFaces[0];
+      block.firstPolygon = face;
+      block.endPolygon = face;
+      block.firstSample = offset;
+      block.nbPoints = nbPoints;
+      block.validate = validate;
+      blocks.push_back(block);
+    }
+    blocks.back().endPolygon = face + 1;
+
+    if(validate && counts[face] < 3)
+    {
+      MString countStr;
+      countStr.set(counts[face]);
+      error = "Polygon with "+countStr+" vertices not supported.";
+      return false;
+    }
+    offset += counts[face];
+  }
+
+  if(offset != nbSamples)
+  {
+    error = "Corrupt mayaCounts vs mayaIndices.";
+    return false;
+  }
+
+  if(allowParallel && nbSamples >= parallelSamples && blocks.size() > 1)
+  {
+    MThreadPool::init();
+    MThreadPool::newParallelRegion(preparePolygonMeshTopologyParallel, &blocks);
+    MThreadPool::release();
+  }
+  else
+  {
+    for(size_t i=0;i<blocks.size();i++)
+    {
+      preparePolygonMeshTopologyBlock(&blocks[i]);
+      if(blocks[i].error.length() > 0)
+        break;
+    }
+  }
+
+  // report the first error in polygon order
+  for(size_t i=0;i<blocks.size();i++)
+  {
+    if(blocks[i].error.length() > 0)
+    {
+      error = blocks[i].error;
+      return false;
+    }
+  }
+  return true;
+}
+
+// the data of a single output mesh. it is pulled from KL on the main
+// thread, the maya mesh is then built from it without touching KL or
+// the data block, so that the meshes of an array can be built in parallel.
+struct PolygonMeshBuffers
+{
+  PolygonMeshOutputCache * cache;
+  bool trustedTopology;
+  bool allowParallel;
+  MObject currentMesh;
+  MObject meshObject;
+
+  unsigned int nbPoints;
+  unsigned int nbPolygons;
+  unsigned int nbSamples;
+  MPointArray points;
+  MVectorArray normals;
+  MIntArray counts;
+  MIntArray indices;
+  bool hasUVs;
+  bool hasVertexColors;
+  MFloatArray uvValues;
+  MColorArray colorValues;
+
+  bool updatedInPlace;
+  MString error;
+  double buildTime;
+};
+
+void pullPolygonMeshBuffers(FabricCore::RTVal rtMesh, PolygonMeshBuffers & buffers)
+{
+  buffers.nbPoints = 0;
+  buffers.nbPolygons = 0;
+  buffers.nbSamples = 0;
+  buffers.hasUVs = false;
+  buffers.hasVertexColors = false;
+  buffers.updatedInPlace = false;
+  buffers.buildTime = 0.0;
+
+  if(!rtMesh.isNullObject())
+  {
+    buffers.nbPoints = rtMesh.callMethod("UInt64", "pointCount", 0, 0).getUInt64();
+    buffers.nbPolygons = rtMesh.callMethod("UInt64", "polygonCount", 0, 0).getUInt64();
+    buffers.nbSamples = rtMesh.callMethod("UInt64", "polygonPointsCount", 0, 0).getUInt64();
+  }
+
+  buffers.points.setLength(buffers.nbPoints);
+  if(buffers.points.length() > 0)
   {
     std::vector<FabricCore::RTVal> args(2);
-    args[0] = FabricSplice::constructExternalArrayRTVal("Float64", mayaPoints.length() * 4, &mayaPoints[0]);
+    args[0] = FabricSplice::constructExternalArrayRTVal("Float64", buffers.points.length() * 4, &buffers.points[0]);
     args[1] = FabricSplice::constructUInt32RTVal(4); // components
     rtMesh.callMethod("", "getPointsAsExternalArray_d", 2, &args[0]);
   }
 
-  mayaNormals.setLength(nbSamples);
-  if(mayaNormals.length() > 0)
+  buffers.normals.setLength(buffers.nbSamples);
+  if(buffers.normals.length() > 0)
   {
     FabricCore::RTVal normalsVar = 
-    FabricSplice::constructExternalArrayRTVal("Float64", mayaNormals.length() * 3, &mayaNormals[0]);
+    FabricSplice::constructExternalArrayRTVal("Float64", buffers.normals.length() * 3, &buffers.normals[0]);
     rtMesh.callMethod("", "getNormalsAsExternalArray_d", 1, &normalsVar);
   }
 
-  mayaCounts.setLength(nbPolygons);
-  mayaIndices.setLength(nbSamples);
-  if(mayaCounts.length() > 0 && mayaIndices.length() > 0)
+  buffers.counts.setLength(buffers.nbPolygons);
+  buffers.indices.setLength(buffers.nbSamples);
+  if(buffers.counts.length() > 0 && buffers.indices.length() > 0)
   {
     std::vector<FabricCore::RTVal> args(2);
-    args[0] = FabricSplice::constructExternalArrayRTVal("UInt32", mayaCounts.length(), &mayaCounts[0]);
-    args[1] = FabricSplice::constructExternalArrayRTVal("UInt32", mayaIndices.length(), &mayaIndices[0]);
+    args[0] = FabricSplice::constructExternalArrayRTVal("UInt32", buffers.counts.length(), &buffers.counts[0]);
+    args[1] = FabricSplice::constructExternalArrayRTVal("UInt32", buffers.indices.length(), &buffers.indices[0]);
     rtMesh.callMethod("", "getTopologyAsCountsIndicesExternalArrays", 2, &args[0]);
   }
 
-  MFnMeshData meshDataFn;
-  MObject meshObject;
+  buffers.hasUVs = buffers.nbSamples > 0 && rtMesh.callMethod("Boolean", "hasUVs", 0, 0).getBoolean();
+  buffers.hasVertexColors = buffers.nbSamples > 0 && rtMesh.callMethod("Boolean", "hasVertexColors", 0, 0).getBoolean();
+
+  if(buffers.hasUVs)
+  {
+    buffers.uvValues.setLength(buffers.nbSamples*2);
+    std::vector<FabricCore::RTVal> args(2);
+    args[0] = FabricSplice::constructExternalArrayRTVal("Float32", buffers.uvValues.length(), &buffers.uvValues[0]);
+    args[1] = FabricSplice::constructUInt32RTVal(2); // components
+    rtMesh.callMethod("", "getUVsAsExternalArray", 2, &args[0]);
+  }
+
+  if(buffers.hasVertexColors)
+  {
+    buffers.colorValues.setLength(buffers.nbSamples);
+    std::vector<FabricCore::RTVal> args(2);
+    args[0] = FabricSplice::constructExternalArrayRTVal("Float32", buffers.colorValues.length() * 4, &buffers.colorValues[0]);
+    args[1] = FabricSplice::constructUInt32RTVal(4); // components
+    rtMesh.callMethod("", "getVertexColorsAsExternalArray", 2, &args[0]);
+  }
+}
+
+MThreadRetVal buildPolygonMesh(void * data)
+{
+  PolygonMeshBuffers & buffers = *(PolygonMeshBuffers*)data;
+  PolygonMeshOutputCache * cache = buffers.cache;
+
+  MTimer timer;
+  timer.beginTimer();
+
+  unsigned int nbPoints = buffers.nbPoints;
+  unsigned int nbPolygons = buffers.nbPolygons;
+  unsigned int nbSamples = buffers.nbSamples;
+  MPointArray & mayaPoints = buffers.points;
+  MVectorArray & mayaNormals = buffers.normals;
+  MIntArray & mayaCounts = buffers.counts;
+  MIntArray & mayaIndices = buffers.indices;
+
+  uint64_t topologyHash = hashMeshStream(&nbPoints, sizeof(nbPoints));
+  topologyHash = hashMeshStream(&buffers.hasUVs, sizeof(buffers.hasUVs), topologyHash);
+  topologyHash = hashMeshStream(&buffers.hasVertexColors, sizeof(buffers.hasVertexColors), topologyHash);
+  topologyHash = hashMeshArray(mayaCounts, sizeof(int), topologyHash);
+  topologyHash = hashMeshArray(mayaIndices, sizeof(int), topologyHash);
+  uint64_t normalsHash = hashMeshArray(mayaNormals, sizeof(double) * 3);
+  uint64_t uvsHash = hashMeshArray(buffers.uvValues, sizeof(float));
+  uint64_t colorsHash = hashMeshArray(buffers.colorValues, sizeof(float) * 4);
+
+  // fast path: the topology didn't change since the last time, so we
+  // update the previously emitted mesh in place instead of recreating it
+  if(cache && cache->valid && cache->topologyHash == topologyHash && cache->sampleIndices.length() == nbSamples &&
+    mayaPoints.length() > 0 && mayaCounts.length() > 0 && mayaIndices.length() > 0)
+  {
+    MStatus meshStatus;
+    MFnMesh mesh(buffers.currentMesh, &meshStatus);
+    if(meshStatus == MS::kSuccess && mesh.numVertices() == (int)nbPoints && 
+      mesh.numPolygons() == (int)nbPolygons && mesh.numFaceVertices() == (int)nbSamples)
+    {
+      mesh.setPoints(mayaPoints);
+
+      if(cache->normalsHash != normalsHash)
+        mesh.setFaceVertexNormals(mayaNormals, cache->sampleFaces, cache->sampleIndices);
+
+      if(buffers.hasUVs && cache->uvsHash != uvsHash)
+      {
+        MFloatArray u, v;
+        u.setLength(nbSamples);
+        v.setLength(nbSamples);
+        unsigned int offset = 0;
+        for(unsigned int i=0;i<u.length();i++)
+        {
+          u[i] = buffers.uvValues[offset++];
+          v[i] = buffers.uvValues[offset++];
+        }
+        mesh.setUVs(u, v);
+      }
+
+      if(buffers.hasVertexColors && cache->colorsHash != colorsHash)
+        mesh.setFaceVertexColors(buffers.colorValues, cache->sampleFaces, cache->sampleIndices);
+
+      cache->valid = true;
+      cache->normalsHash = normalsHash;
+      cache->uvsHash = uvsHash;
+      cache->colorsHash = colorsHash;
+
+      buffers.updatedInPlace = true;
+      timer.endTimer();
+      buffers.buildTime = timer.elapsedTime();
+      return 0;
+    }
+  }
+
+  if(cache)
+    cache->valid = false;
+
+  // the mesh data is only needed when the mesh is recreated
+  if(buffers.meshObject.isNull())
+    buffers.meshObject = MFnMeshData().create();
+
   MFnMesh mesh;
-  meshObject = meshDataFn.create();
   if(mayaPoints.length() == 0 || mayaCounts.length() == 0 || mayaIndices.length() == 0)
   {
     mayaPoints.setLength(0);
@@ -2509,133 +2908,37 @@ void portToPlug_PolygonMesh_singleMesh(MDataHandle handle, FabricCore::RTVal rtM
     mayaIndices.append(0);
     mayaIndices.append(1);
     mayaIndices.append(2);
-    mesh.create(mayaPoints.length(), mayaCounts.length(), mayaPoints, mayaCounts, mayaIndices, meshObject);  
+    mesh.create(mayaPoints.length(), mayaCounts.length(), mayaPoints, mayaCounts, mayaIndices, buffers.meshObject);  
     mesh.updateSurface();
   }
   else
   {
-    MIntArray normalFace, normalVertex;
+    MIntArray normalFace;
     normalFace.setLength(mayaIndices.length());
-    normalVertex.setLength(mayaIndices.length());        
-
-    int face = 0;
-    int vertex = 0;
-    int offset = 0;
 
-    if(mayaCounts[face] != 3 && mayaCounts[face] != 4)
+    MString validationError;
+    if(!preparePolygonMeshTopology(mayaCounts, mayaIndices, nbPoints, normalFace, !buffers.trustedTopology, validationError, buffers.allowParallel))
     {
-      MString mayaCountStr;
-      mayaCountStr.set(mayaCounts[face]);
-      mayaLogErrorFunc("PolygonMesh: Polygon with "+mayaCountStr+" vertices not supported.");
-      return;
+      buffers.error = "PolygonMesh: "+validationError;
+      return 0;
     }
 
-    for(unsigned int i=0;i<mayaIndices.length();i++) {
-      normalFace[i] = face;
-      normalVertex[i] = mayaIndices[offset + vertex];
-
-      if(vertex == 0)
-      {
-        int v0 = mayaIndices[offset];
-        int v1 = mayaIndices[offset+1];
-        int v2 = mayaIndices[offset+2];
-        if(v0 >= mayaPoints.length())
-        {
-          MString indexStr;
-          indexStr.set(v0);
-          mayaLogErrorFunc("PolygonMesh: Point "+indexStr+" out of range.");
-          return;
-        }
-        if(v1 >= mayaPoints.length())
-        {
-          MString indexStr;
-          indexStr.set(v1);
-          mayaLogErrorFunc("PolygonMesh: Point "+indexStr+" out of range.");
-          return;
-        }
-        if(v2 >= mayaPoints.length())
-        {
-          MString indexStr;
-          indexStr.set(v2);
-          mayaLogErrorFunc("PolygonMesh: Point "+indexStr+" out of range.");
-          return;
-        }
-        if(v0 == v1 || v0 == v2 || v1 == v2)
-        {
-          MString indexStr;
-          indexStr.set(face);
-          mayaLogErrorFunc("PolygonMesh: Polygon corrupt polygon ["+indexStr+"].");
-          return;
-        }
-        if(mayaCounts[face] > 3)
-        {
-          int v3 = mayaIndices[offset+3];
-          if(v3 >= mayaPoints.length())
-          {
-            MString indexStr;
-            indexStr.set(v3);
-            mayaLogErrorFunc("PolygonMesh: Point "+indexStr+" out of range.");
-            return;
-          }
-          if(v3 == v0 || v3 == v1 || v3 == v2)
-          {
-            MString indexStr;
-            indexStr.set(face);
-            mayaLogErrorFunc("PolygonMesh: Polygon corrupt polygon ["+indexStr+"].");
-            return;
-          }
-        }
-      }
-
-      vertex++;
-
-      if(vertex == mayaCounts[face])
-      {
-        offset += mayaCounts[face];
-        face++;
-        vertex = 0;
-
-        if(face == mayaCounts.length())
-        {
-          if(i != mayaIndices.length() - 1)
-          {
-            mayaLogErrorFunc("PolygonMesh: Corrupt mayaCounts vs mayaIndices.");
-            return;
-          }
-        }
-        else if(mayaCounts[face] != 3 && mayaCounts[face] != 4)
-        {
-          MString mayaCountStr;
-          mayaCountStr.set(mayaCounts[face]);
-          mayaLogErrorFunc("PolygonMesh: Polygon with "+mayaCountStr+" vertices not supported.");
-          return;
-        }
-      }
-    }
-  
-    mesh.create(mayaPoints.length(), mayaCounts.length(), mayaPoints, mayaCounts, mayaIndices, meshObject);  
+    mesh.create(mayaPoints.length(), mayaCounts.length(), mayaPoints, mayaCounts, mayaIndices, buffers.meshObject);  
     mesh.updateSurface();
     mayaPoints.clear();
-    mesh.setFaceVertexNormals( mayaNormals, normalFace, normalVertex );
+    mesh.setFaceVertexNormals( mayaNormals, normalFace, mayaIndices );
 
-    if(rtMesh.callMethod("Boolean", "hasUVs", 0, 0).getBoolean())
+    if(buffers.hasUVs)
     {
-      MFloatArray values(nbSamples*2);
-      std::vector<FabricCore::RTVal> args(2);
-      args[0] = FabricSplice::constructExternalArrayRTVal("Float32", values.length(), &values[0]);
-      args[1] = FabricSplice::constructUInt32RTVal(2); // components
-      rtMesh.callMethod("", "getUVsAsExternalArray", 2, &args[0]);
-
       MFloatArray u, v;
       u.setLength(nbSamples);      
       v.setLength(nbSamples);      
       unsigned int offset = 0;
       for(unsigned int i=0;i<u.length();i++)
       {
-        u[i] = values[offset++];
-        v[i] = values[offset++];
+        u[i] = buffers.uvValues[offset++];
+        v[i] = buffers.uvValues[offset++];
       }
-      values.clear();
       MString setName("map1");
       mesh.createUVSet(setName);
       mesh.setCurrentUVSetName(setName);
@@ -2648,40 +2951,88 @@ void portToPlug_PolygonMesh_singleMesh(MDataHandle handle, FabricCore::RTVal rtM
       mesh.assignUVs(mayaCounts, indices);
     }
 
-    if(rtMesh.callMethod("Boolean", "hasVertexColors", 0, 0).getBoolean())
+    if(buffers.hasVertexColors)
     {
-      MColorArray values(nbSamples);
-      std::vector<FabricCore::RTVal> args(2);
-      args[0] = FabricSplice::constructExternalArrayRTVal("Float32", values.length() * 4, &values[0]);
-      args[1] = FabricSplice::constructUInt32RTVal(4); // components
-      rtMesh.callMethod("", "getVertexColorsAsExternalArray", 2, &args[0]);
-
       MString setName("colorSet");
       mesh.createColorSet(setName);
       mesh.setCurrentColorSetName(setName);
 
-      MIntArray face(nbSamples);
-
-      unsigned int offset = 0;
-      for(unsigned int i=0;i<mayaCounts.length();i++)
-      {
-        for(unsigned int j=0;j<mayaCounts[i];j++,offset++)
-        {
-          face[offset] = i;
-        }
-      }
+      // normalFace holds the face of each polygon point as well
+      mesh.setFaceVertexColors(buffers.colorValues, normalFace, mayaIndices);
+    }
 
-      mesh.setFaceVertexColors(values, face, mayaIndices);
+    if(cache)
+    {
+      cache->valid = true;
+      cache->topologyHash = topologyHash;
+      cache->normalsHash = normalsHash;
+      cache->uvsHash = uvsHash;
+      cache->colorsHash = colorsHash;
+      cache->sampleFaces = normalFace;
+      cache->sampleIndices = mayaIndices;
     }
+  }
+
+  timer.endTimer();
+  buffers.buildTime = timer.elapsedTime();
+  return 0;
+}
 
-    handle.set(meshObject);
-    handle.setClean();
+void buildPolygonMeshesParallel(void * data, MThreadRootTask * root)
+{
+  std::vector<PolygonMeshBuffers> & meshes = *(std::vector<PolygonMeshBuffers>*)data;
+  for(size_t i=0;i<meshes.size();i++)
+    MThreadPool::createTask(buildPolygonMesh, &meshes[i], root);
+  MThreadPool::executeAndJoin(root);
+}
+
+void commitPolygonMesh(MDataHandle handle, PolygonMeshBuffers & buffers)
+{
+  if(buffers.error.length() > 0)
+  {
+    mayaLogErrorFunc(buffers.error);
+    return;
   }
+  if(!buffers.updatedInPlace)
+    handle.set(buffers.meshObject);
+  handle.setClean();
+}
+
+void portToPlug_PolygonMesh_singleMesh(MDataHandle handle, FabricCore::RTVal rtMesh, PolygonMeshOutputCache * cache = NULL, bool trustedTopology = false)
+{
+  CORE_CATCH_BEGIN;
+
+  PolygonMeshBuffers buffers;
+  buffers.cache = cache;
+  buffers.trustedTopology = trustedTopology;
+  buffers.allowParallel = true;
+  buffers.currentMesh = handle.asMesh();
+
+  pullPolygonMeshBuffers(rtMesh, buffers);
+  buildPolygonMesh(&buffers);
+  commitPolygonMesh(handle, buffers);
 
   CORE_CATCH_END;
 }
 
-void portToPlug_PolygonMesh(FabricSplice::DGPort & port, MPlug &plug, MDataBlock &data){
+bool gConversionProfiling = false;
+void setConversionProfiling(bool enabled)
+{
+  gConversionProfiling = enabled;
+}
+
+void portToPlug_PolygonMesh_cached(FabricSplice::DGPort & port, MPlug &plug, MDataBlock &data, SpliceConversionCache * conversionCache){
+
+  // graphs known to produce valid meshes can skip the validation
+  bool trustedTopology = false;
+  if(port.hasOption("trustedTopology"))
+    trustedTopology = port.getOption("trustedTopology").getBoolean();
+
+  // arrays of meshes are built in parallel unless disabled on the port
+  bool parallelMeshes = true;
+  if(port.hasOption("parallelMeshes"))
+    parallelMeshes = port.getOption("parallelMeshes").getBoolean();
+
   try
   {
     if(plug.isArray())
@@ -2691,8 +3042,101 @@ void portToPlug_PolygonMesh(FabricSplice::DGPort & port, MPlug &plug, MDataBlock
 
       unsigned int elements = port.getArrayCount();
       FabricCore::RTVal polygonMeshArray = port.getRTVal();
-      for(unsigned int i = 0; i < elements; ++i)
-        portToPlug_PolygonMesh_singleMesh(arraybuilder.addElement(i), polygonMeshArray.getArrayElement(i));
+      if(conversionCache)
+        conversionCache->meshOutputs.resize(elements);
+
+      if(!parallelMeshes || elements < 2)
+      {
+        for(unsigned int i = 0; i < elements; ++i)
+        {
+          PolygonMeshOutputCache * cache = conversionCache ? &conversionCache->meshOutputs[i] : NULL;
+          portToPlug_PolygonMesh_singleMesh(arraybuilder.addElement(i), polygonMeshArray.getArrayElement(i), cache, trustedTopology);
+        }
+      }
+      else
+      {
+        MTimer timer;
+        timer.beginTimer();
+
+        // pull all KL buffers on the main thread
+        std::vector<PolygonMeshBuffers> meshes(elements);
+        std::vector<MDataHandle> handles(elements);
+        {
+          FabricSplice::Logging::AutoTimer pullTimer("Maya::portToPlug_PolygonMesh::pull");
+          for(unsigned int i = 0; i < elements; ++i)
+          {
+            handles[i] = arraybuilder.addElement(i);
+
+            PolygonMeshBuffers & buffers = meshes[i];
+            buffers.cache = conversionCache ? &conversionCache->meshOutputs[i] : NULL;
+            buffers.trustedTopology = trustedTopology;
+            buffers.allowParallel = false;
+            buffers.currentMesh = handles[i].asMesh();
+            // created on the main thread, the worker threads only fill it
+            buffers.meshObject = MFnMeshData().create();
+            pullPolygonMeshBuffers(polygonMeshArray.getArrayElement(i), buffers);
+          }
+        }
+        timer.endTimer();
+        double pullTime = timer.elapsedTime();
+
+        // build the maya meshes across the thread pool
+        timer.beginTimer();
+        {
+          FabricSplice::Logging::AutoTimer buildTimer("Maya::portToPlug_PolygonMesh::build");
+          MThreadPool::init();
+          MThreadPool::newParallelRegion(buildPolygonMeshesParallel, &meshes);
+          MThreadPool::release();
+        }
+        timer.endTimer();
+        double buildTime = timer.elapsedTime();
+
+        // commit them to the builder on the main thread
+        timer.beginTimer();
+        {
+          FabricSplice::Logging::AutoTimer commitTimer("Maya::portToPlug_PolygonMesh::commit");
+          for(unsigned int i = 0; i < elements; ++i)
+            commitPolygonMesh(handles[i], meshes[i]);
+        }
+        timer.endTimer();
+        double commitTime = timer.elapsedTime();
+
+        if(gConversionProfiling)
+        {
+          double sumTime = 0.0;
+          double maxTime = 0.0;
+          unsigned int inPlace = 0;
+          for(unsigned int i = 0; i < elements; ++i)
+          {
+            sumTime += meshes[i].buildTime;
+            if(meshes[i].buildTime > maxTime)
+              maxTime = meshes[i].buildTime;
+            if(meshes[i].updatedInPlace)
+              inPlace++;
+          }
+
+          MString message = "Maya::portToPlug_PolygonMesh: '";
+          message += plug.name();
+          message += "' ";
+          message += (int)elements;
+          message += " meshes (";
+          message += (int)inPlace;
+          message += " updated in place) on ";
+          message += MThreadUtils::getNumThreads();
+          message += " threads. pull ";
+          message += pullTime * 1000.0;
+          message += " ms, build ";
+          message += buildTime * 1000.0;
+          message += " ms (";
+          message += sumTime * 1000.0;
+          message += " ms of work, slowest mesh ";
+          message += maxTime * 1000.0;
+          message += " ms), commit ";
+          message += commitTime * 1000.0;
+          message += " ms.";
+          mayaLogFunc(message);
+        }
+      }
 
       arrayHandle.set(arraybuilder);
       arrayHandle.setAllClean();
@@ -2700,7 +3144,13 @@ void portToPlug_PolygonMesh(FabricSplice::DGPort & port, MPlug &plug, MDataBlock
     else
     {
       MDataHandle handle = data.outputValue(plug.attribute());
-      portToPlug_PolygonMesh_singleMesh(handle, port.getRTVal());
+      PolygonMeshOutputCache * cache = NULL;
+      if(conversionCache)
+      {
+        conversionCache->meshOutputs.resize(1);
+        cache = &conversionCache->meshOutputs[0];
+      }
+      portToPlug_PolygonMesh_singleMesh(handle, port.getRTVal(), cache, trustedTopology);
     }
   }
   catch(FabricCore::Exception e)
@@ -2715,6 +3165,10 @@ void portToPlug_PolygonMesh(FabricSplice::DGPort & port, MPlug &plug, MDataBlock
   }
 }
 
+void portToPlug_PolygonMesh(FabricSplice::DGPort & port, MPlug &plug, MDataBlock &data){
+  portToPlug_PolygonMesh_cached(port, plug, data, NULL);
+}
+
 void portToPlug_Lines_singleLines(MDataHandle handle, FabricCore::RTVal rtVal)
 {
   CORE_CATCH_BEGIN;
@@ -2881,6 +3335,22 @@ SplicePlugToPortFunc getSplicePlugToPortFunc(const std::string & dataType, const
   return NULL;  
 }
 
+SpliceCachedPlugToPortFunc getSpliceCachedPlugToPortFunc(const std::string & dataType)
+{
+  if(dataType == "PolygonMesh")
+    return plugToPort_PolygonMesh_cached;
+
+  return NULL;
+}
+
+SpliceCachedPortToPlugFunc getSpliceCachedPortToPlugFunc(const std::string & dataType)
+{
+  if(dataType == "PolygonMesh")
+    return portToPlug_PolygonMesh_cached;
+
+  return NULL;
+}
+
 SplicePortToPlugFunc getSplicePortToPlugFunc(const std::string & dataType, const FabricSplice::DGPort * port)
 {
   if(dataType == "CompoundParam")
@@ -2911,6 +3381,28 @@ SplicePortToPlugFunc getSplicePortToPlugFunc(const std::string & dataType, const
   return NULL;  
 }
 
+// returns the size in bytes of a single element of the given type,
+// or 0 if the type's value can't be compared by its memory.
+size_t getSpliceDataTypePODSize(const std::string & dataType)
+{
+  if(dataType == "Boolean")
+    return 1;
+  if(dataType == "Integer")
+    return 4; // SInt32
+  if(dataType == "Scalar")
+    return 4; // Float32
+  if(dataType == "Color")
+    return 16; // r, g, b, a
+  if(dataType == "Vec3")
+    return 12;
+  if(dataType == "Euler")
+    return 16; // Vec3 angles + RotationOrder
+  if(dataType == "Mat44")
+    return 64;
+
+  return 0;
+}
+
 MString getSpliceDataTypeFromMPlug(const MPlug &plug){
   MString dataType = "";
   MStatus handleStat;
@@ -2967,3 +3459,46 @@ MString getSpliceDataTypeFromMPlug(const MPlug &plug){
 
   return dataType;
 }
+
+MStringArray benchmarkConversionKernels(unsigned int count)
+{
+  MStringArray results;
+  if(count == 0)
+    return results;
+
+  std::vector<double> double3Values(count * 3, 1.0);
+  std::vector<double> double4Values(count * 4, 1.0);
+  std::vector<float> float3Values(count * 3, 1.0f);
+
+  const char * names[4] = {
+    "double3 -> float3",
+    "double4 -> float3",
+    "float3 -> double3",
+    "float3 -> double4"
+  };
+
+  for(unsigned int kernel = 0; kernel < 4; ++kernel){
+    MTimer timer;
+    timer.beginTimer();
+    switch(kernel){
+      case 0: convertDouble3ToFloat3(&double3Values[0], &float3Values[0], count); break;
+      case 1: convertDouble4ToFloat3(&double4Values[0], &float3Values[0], count); break;
+      case 2: convertFloat3ToDouble3(&float3Values[0], &double3Values[0], count); break;
+      case 3: convertFloat3ToDouble4(&float3Values[0], &double4Values[0], count); break;
+    }
+    timer.endTimer();
+
+    double seconds = timer.elapsedTime();
+    MString result;
+    result += names[kernel];
+    result += " (";
+    result += getConversionKernelsISA();
+    result += "): ";
+    result += seconds * 1000.0;
+    result += " ms, ";
+    result += seconds > 0.0 ? double(count) / seconds / 1000000.0 : 0.0;
+    result += " Mvec/s";
+    results.append(result);
+  }
+  return results;
+}
@@ -12,9 +12,12 @@
 #include <maya/MFnNumericData.h>
 #include <maya/MStringArray.h>
 #include <maya/MDataHandle.h>
+#include <maya/MIntArray.h>
 
 #include <FabricSplice.h>
 
+#include <stdint.h>
+
 #define MAYASPLICE_MEMORY_ALLOCATE(type, count) size_t valuesSize = sizeof(type) * count; type * values = (type*) malloc(valuesSize)
 #define MAYASPLICE_MEMORY_SETITEM(index, value) values[index] = value
 #define MAYASPLICE_MEMORY_GETITEM(index) values[index]
@@ -25,8 +28,87 @@
 typedef void(*SplicePlugToPortFunc)(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port);
 typedef void(*SplicePortToPlugFunc)(FabricSplice::DGPort & port, MPlug &plug, MDataBlock &data);
 
+// what has been uploaded into the PolygonMesh of an input plug (or an
+// element of it) last time, so that unchanged streams can be skipped.
+struct PolygonMeshInputCache
+{
+  PolygonMeshInputCache() { reset(); }
+
+  FabricCore::RTVal polygonMesh;
+  unsigned int numVertices;
+  uint64_t topologyHash;
+  uint64_t pointsHash;
+  uint64_t normalsHash;
+  uint64_t uvsHash;
+  uint64_t colorsHash;
+
+  void reset()
+  {
+    polygonMesh = FabricCore::RTVal();
+    numVertices = 0;
+    topologyHash = 0;
+    pointsHash = 0;
+    normalsHash = 0;
+    uvsHash = 0;
+    colorsHash = 0;
+  }
+};
+
+// what has been emitted for an output plug (or an element of it) last
+// time, so that meshes keeping their topology can be updated in place.
+struct PolygonMeshOutputCache
+{
+  PolygonMeshOutputCache() { reset(); }
+
+  bool valid;
+  uint64_t topologyHash;
+  uint64_t normalsHash;
+  uint64_t uvsHash;
+  uint64_t colorsHash;
+  MIntArray sampleFaces;
+  MIntArray sampleIndices;
+
+  void reset()
+  {
+    valid = false;
+    topologyHash = 0;
+    normalsHash = 0;
+    uvsHash = 0;
+    colorsHash = 0;
+    sampleFaces.clear();
+    sampleIndices.clear();
+  }
+};
+
+// the state a conversion keeps for a port across evaluations, owned by
+// the node's binding of the port. indexed by the element of the plug.
+struct SpliceConversionCache
+{
+  std::vector<PolygonMeshInputCache> meshInputs;
+  std::vector<PolygonMeshOutputCache> meshOutputs;
+
+  void clear()
+  {
+    meshInputs.clear();
+    meshOutputs.clear();
+  }
+};
+
+typedef void(*SpliceCachedPlugToPortFunc)(MPlug &plug, MDataBlock &data, FabricSplice::DGPort & port, SpliceConversionCache * cache);
+typedef void(*SpliceCachedPortToPlugFunc)(FabricSplice::DGPort & port, MPlug &plug, MDataBlock &data, SpliceConversionCache * cache);
+
 SplicePlugToPortFunc getSplicePlugToPortFunc(const std::string & dataType, const FabricSplice::DGPort * port = NULL);
 SplicePortToPlugFunc getSplicePortToPlugFunc(const std::string & dataType, const FabricSplice::DGPort * port = NULL);
+// the conversions which keep state across evaluations, NULL for all other types
+SpliceCachedPlugToPortFunc getSpliceCachedPlugToPortFunc(const std::string & dataType);
+SpliceCachedPortToPlugFunc getSpliceCachedPortToPlugFunc(const std::string & dataType);
 MString getSpliceDataTypeFromMPlug(const MPlug &plug);
+size_t getSpliceDataTypePODSize(const std::string & dataType);
+
+// enables additional reports of the conversions while profiling
+void setConversionProfiling(bool enabled);
+
+// runs the vec3 conversion kernels on count vectors, returns a line per kernel
+MStringArray benchmarkConversionKernels(unsigned int count);
 
 #endif
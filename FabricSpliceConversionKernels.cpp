@@ -0,0 +1,110 @@
+#include "FabricSpliceConversionKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define MAYASPLICE_KERNELS_SSE2
+# include <emmintrin.h>
+#endif
+
+void convertDouble3ToFloat3(const double * src, float * dst, size_t count)
+{
+  size_t i = 0;
+#ifdef MAYASPLICE_KERNELS_SSE2
+  // 4 vectors per iteration: 12 doubles in, 12 floats out
+  for(; i + 4 <= count; i += 4){
+    const double * s = src + i * 3;
+    float * d = dst + i * 3;
+    __m128 a = _mm_cvtpd_ps(_mm_loadu_pd(s));
+    __m128 b = _mm_cvtpd_ps(_mm_loadu_pd(s + 2));
+    __m128 c = _mm_cvtpd_ps(_mm_loadu_pd(s + 4));
+    __m128 e = _mm_cvtpd_ps(_mm_loadu_pd(s + 6));
+    __m128 f = _mm_cvtpd_ps(_mm_loadu_pd(s + 8));
+    __m128 g = _mm_cvtpd_ps(_mm_loadu_pd(s + 10));
+    _mm_storeu_ps(d, _mm_movelh_ps(a, b));
+    _mm_storeu_ps(d + 4, _mm_movelh_ps(c, e));
+    _mm_storeu_ps(d + 8, _mm_movelh_ps(f, g));
+  }
+#endif
+  for(; i < count; ++i){
+    dst[i * 3 + 0] = (float)src[i * 3 + 0];
+    dst[i * 3 + 1] = (float)src[i * 3 + 1];
+    dst[i * 3 + 2] = (float)src[i * 3 + 2];
+  }
+}
+
+void convertDouble4ToFloat3(const double * src, float * dst, size_t count)
+{
+  size_t i = 0;
+#ifdef MAYASPLICE_KERNELS_SSE2
+  // each point is stored as x,y,z,w. the 4th float written lands on
+  // the next point's x and gets overwritten, so the last point is
+  // converted by the scalar loop to stay within dst.
+  for(; i + 1 < count; ++i){
+    const double * s = src + i * 4;
+    __m128 xy = _mm_cvtpd_ps(_mm_loadu_pd(s));
+    __m128 zw = _mm_cvtpd_ps(_mm_loadu_pd(s + 2));
+    _mm_storeu_ps(dst + i * 3, _mm_movelh_ps(xy, zw));
+  }
+#endif
+  for(; i < count; ++i){
+    dst[i * 3 + 0] = (float)src[i * 4 + 0];
+    dst[i * 3 + 1] = (float)src[i * 4 + 1];
+    dst[i * 3 + 2] = (float)src[i * 4 + 2];
+  }
+}
+
+void convertFloat3ToDouble3(const float * src, double * dst, size_t count)
+{
+  size_t i = 0;
+#ifdef MAYASPLICE_KERNELS_SSE2
+  // 4 vectors per iteration: 12 floats in, 12 doubles out
+  for(; i + 4 <= count; i += 4){
+    const float * s = src + i * 3;
+    double * d = dst + i * 3;
+    __m128 a = _mm_loadu_ps(s);
+    __m128 b = _mm_loadu_ps(s + 4);
+    __m128 c = _mm_loadu_ps(s + 8);
+    _mm_storeu_pd(d, _mm_cvtps_pd(a));
+    _mm_storeu_pd(d + 2, _mm_cvtps_pd(_mm_movehl_ps(a, a)));
+    _mm_storeu_pd(d + 4, _mm_cvtps_pd(b));
+    _mm_storeu_pd(d + 6, _mm_cvtps_pd(_mm_movehl_ps(b, b)));
+    _mm_storeu_pd(d + 8, _mm_cvtps_pd(c));
+    _mm_storeu_pd(d + 10, _mm_cvtps_pd(_mm_movehl_ps(c, c)));
+  }
+#endif
+  for(; i < count; ++i){
+    dst[i * 3 + 0] = src[i * 3 + 0];
+    dst[i * 3 + 1] = src[i * 3 + 1];
+    dst[i * 3 + 2] = src[i * 3 + 2];
+  }
+}
+
+void convertFloat3ToDouble4(const float * src, double * dst, size_t count, double w)
+{
+  size_t i = 0;
+#ifdef MAYASPLICE_KERNELS_SSE2
+  // loading 4 floats reads the next point's x, so the last point
+  // is converted by the scalar loop to stay within src.
+  __m128d ww = _mm_set1_pd(w);
+  for(; i + 1 < count; ++i){
+    __m128 p = _mm_loadu_ps(src + i * 3);
+    double * d = dst + i * 4;
+    _mm_storeu_pd(d, _mm_cvtps_pd(p));
+    _mm_storeu_pd(d + 2, _mm_unpacklo_pd(_mm_cvtps_pd(_mm_movehl_ps(p, p)), ww));
+  }
+#endif
+  for(; i < count; ++i){
+    dst[i * 4 + 0] = src[i * 3 + 0];
+    dst[i * 4 + 1] = src[i * 3 + 1];
+    dst[i * 4 + 2] = src[i * 3 + 2];
+    dst[i * 4 + 3] = w;
+  }
+}
+
+const char * getConversionKernelsISA()
+{
+#ifdef MAYASPLICE_KERNELS_SSE2
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
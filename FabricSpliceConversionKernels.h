@@ -0,0 +1,18 @@
+
+#ifndef _CREATIONSPLICECONVERSIONKERNELS_H_
+#define _CREATIONSPLICECONVERSIONKERNELS_H_
+
+#include <stddef.h>
+
+// bulk stride converting kernels between maya's double precision
+// vector / point arrays and KL's Float32 Vec3 arrays. src and dst
+// must not overlap, count is the number of vectors.
+void convertDouble3ToFloat3(const double * src, float * dst, size_t count);
+void convertDouble4ToFloat3(const double * src, float * dst, size_t count);
+void convertFloat3ToDouble3(const float * src, double * dst, size_t count);
+void convertFloat3ToDouble4(const float * src, double * dst, size_t count, double w = 1.0);
+
+// returns the name of the instruction set the kernels were compiled for
+const char * getConversionKernelsISA();
+
+#endif
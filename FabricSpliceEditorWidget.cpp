@@ -248,6 +248,7 @@ FabricSpliceBaseInterface * FabricSpliceEditorWidget::getCurrentBaseInterface()
   FabricSpliceBaseInterface * node = FabricSpliceBaseInterface::getInstanceByName(nodeName);
   if(node == NULL)
     return NULL;
+  node->restoreDeferredPersistenceData();
   return node;
 }
 
@@ -0,0 +1,237 @@
+#include "FabricSpliceEvaluationCache.h"
+
+#include <string.h>
+
+// FNV-1a
+static uint64_t hashBytes(const char * data, size_t size, uint64_t hash = 14695981039346656037ULL)
+{
+  for(size_t i = 0; i < size; ++i){
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// appends the raw data of a port, prefixed by its size
+static bool appendPortData(const FabricSpliceEvaluationCache::Port & cachePort, std::vector<char> & buffer)
+{
+  FabricSplice::DGPort port = cachePort.port;
+  uint64_t size = 0;
+  size_t offset = buffer.size();
+
+  if(port.isArray()){
+    size = cachePort.valueSize * port.getArrayCount();
+    buffer.resize(offset + sizeof(size) + size);
+    if(size > 0)
+      port.getArrayData(&buffer[offset + sizeof(size)], size);
+  }
+  else{
+    FabricCore::RTVal rtVal = port.getRTVal();
+    const char * rtData = (const char *)rtVal.getData();
+    if(rtData == NULL)
+      return false;
+    size = cachePort.valueSize;
+    buffer.resize(offset + sizeof(size) + size);
+    memcpy(&buffer[offset + sizeof(size)], rtData, size);
+  }
+
+  memcpy(&buffer[offset], &size, sizeof(size));
+  return true;
+}
+
+FabricSpliceEvaluationCache::FabricSpliceEvaluationCache()
+{
+  _enabled = false;
+  _budget = 256 * 1024 * 1024;
+  _memoryUsage = 0;
+  _generation = 0;
+  _hits = 0;
+  _misses = 0;
+  _hasPendingKey = false;
+  _pendingTime = 0.0;
+  _pendingHash = 0;
+}
+
+void FabricSpliceEvaluationCache::setEnabled(bool enabled)
+{
+  _enabled = enabled;
+  if(!_enabled)
+    clear();
+}
+
+void FabricSpliceEvaluationCache::setBudget(size_t bytes)
+{
+  _lock.lock();
+  _budget = bytes;
+  evict();
+  _lock.unlock();
+}
+
+void FabricSpliceEvaluationCache::clear()
+{
+  _lock.lock();
+  _entries.clear();
+  _entriesByHash.clear();
+  _memoryUsage = 0;
+  _generation++;
+  _hasPendingKey = false;
+  _lock.unlock();
+}
+
+void FabricSpliceEvaluationCache::cancelInserts()
+{
+  _lock.lock();
+  _generation++;
+  _lock.unlock();
+}
+
+void FabricSpliceEvaluationCache::resetCounters()
+{
+  _hits = 0;
+  _misses = 0;
+}
+
+bool FabricSpliceEvaluationCache::buildKey(double time, const std::vector<Port> & inputs, std::vector<char> & buffer, uint64_t & hash)
+{
+  buffer.clear();
+  for(size_t i = 0; i < inputs.size(); ++i){
+    if(!appendPortData(inputs[i], buffer))
+      return false;
+  }
+
+  hash = hashBytes((const char *)&time, sizeof(time));
+  if(buffer.size() > 0)
+    hash = hashBytes(&buffer[0], buffer.size(), hash);
+  return true;
+}
+
+void FabricSpliceEvaluationCache::readOutputs(const std::vector<Port> & outputs, Entry & entry)
+{
+  entry.size = sizeof(Entry) + entry.inputs.size();
+  entry.outputs.resize(outputs.size());
+  for(size_t i = 0; i < outputs.size(); ++i){
+    FabricSplice::DGPort port = outputs[i].port;
+    Value & value = entry.outputs[i];
+    value.isArray = port.isArray();
+    if(value.isArray){
+      size_t size = outputs[i].valueSize * port.getArrayCount();
+      value.data.resize(size);
+      if(size > 0)
+        port.getArrayData(&value.data[0], size);
+      entry.size += size;
+    }
+    else{
+      value.rtVal = port.getRTVal();
+      entry.size += outputs[i].valueSize;
+    }
+    entry.size += sizeof(Value);
+  }
+}
+
+bool FabricSpliceEvaluationCache::fetch(double time, const std::vector<Port> & inputs, const std::vector<Port> & outputs)
+{
+  _hasPendingKey = false;
+  if(!_enabled)
+    return false;
+
+  if(!buildKey(time, inputs, _pendingInputs, _pendingHash))
+    return false;
+  _pendingTime = time;
+
+  _lock.lock();
+  std::map<uint64_t, EntryList::iterator>::iterator it = _entriesByHash.find(_pendingHash);
+  if(it != _entriesByHash.end()){
+    Entry & entry = *it->second;
+    if(entry.time == time && entry.inputs == _pendingInputs && entry.outputs.size() == outputs.size()){
+      for(size_t i = 0; i < outputs.size(); ++i){
+        FabricSplice::DGPort port = outputs[i].port;
+        Value & value = entry.outputs[i];
+        if(value.isArray)
+          port.setArrayData(value.data.size() > 0 ? &value.data[0] : NULL, value.data.size());
+        else
+          port.setRTVal(value.rtVal);
+      }
+
+      // move to the front of the list
+      _entries.splice(_entries.begin(), _entries, it->second);
+      _hits++;
+      _lock.unlock();
+      return true;
+    }
+  }
+  _lock.unlock();
+
+  _misses++;
+  _hasPendingKey = true;
+  return false;
+}
+
+void FabricSpliceEvaluationCache::store(const std::vector<Port> & outputs)
+{
+  if(!_enabled || !_hasPendingKey)
+    return;
+  _hasPendingKey = false;
+
+  Entry entry;
+  entry.time = _pendingTime;
+  entry.hash = _pendingHash;
+  entry.inputs.swap(_pendingInputs);
+  readOutputs(outputs, entry);
+  insertEntry(entry, getGeneration());
+}
+
+void FabricSpliceEvaluationCache::insert(double time, const std::vector<Port> & inputs, const std::vector<Port> & outputs, unsigned int generation)
+{
+  if(!_enabled)
+    return;
+
+  Entry entry;
+  entry.time = time;
+  if(!buildKey(time, inputs, entry.inputs, entry.hash))
+    return;
+  readOutputs(outputs, entry);
+  insertEntry(entry, generation);
+}
+
+void FabricSpliceEvaluationCache::insertEntry(Entry & entry, unsigned int generation)
+{
+  _lock.lock();
+
+  // a single entry exceeding the budget is not worth keeping,
+  // neither are the values of a cancelled insert
+  if(entry.size > _budget || generation != (unsigned int)_generation){
+    _lock.unlock();
+    return;
+  }
+
+  // replaces an entry with a colliding hash
+  std::map<uint64_t, EntryList::iterator>::iterator it = _entriesByHash.find(entry.hash);
+  if(it != _entriesByHash.end()){
+    _memoryUsage -= it->second->size;
+    _entries.erase(it->second);
+    _entriesByHash.erase(it);
+  }
+
+  _entries.push_front(Entry());
+  _entries.front().time = entry.time;
+  _entries.front().hash = entry.hash;
+  _entries.front().inputs.swap(entry.inputs);
+  _entries.front().outputs.swap(entry.outputs);
+  _entries.front().size = entry.size;
+  _entriesByHash.insert(std::pair<uint64_t, EntryList::iterator>(entry.hash, _entries.begin()));
+  _memoryUsage += entry.size;
+
+  evict();
+  _lock.unlock();
+}
+
+// expects the lock to be held
+void FabricSpliceEvaluationCache::evict()
+{
+  while(_memoryUsage > _budget && _entries.size() > 0){
+    Entry & entry = _entries.back();
+    _memoryUsage -= entry.size;
+    _entriesByHash.erase(entry.hash);
+    _entries.pop_back();
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef _CREATIONSPLICEEVALUATIONCACHE_H_
+#define _CREATIONSPLICEEVALUATIONCACHE_H_
+
+#include <FabricSplice.h>
+#include <maya/MSpinLock.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// memoizes the outputs of a graph per time and input values, so that
+// scrubbing or looping over frames which have been evaluated already
+// doesn't run KL again. entries are evicted least recently used first
+// once they exceed the memory budget.
+class FabricSpliceEvaluationCache {
+public:
+
+  // a port taking part in the cache. valueSize is the size of a
+  // single value (or array element) of the port's POD type.
+  struct Port {
+    FabricSplice::DGPort port;
+    size_t valueSize;
+  };
+
+  FabricSpliceEvaluationCache();
+
+  void setEnabled(bool enabled);
+  bool isEnabled() const { return _enabled; }
+  void setBudget(size_t bytes);
+  size_t getBudget() const { return _budget; }
+  size_t getMemoryUsage() const { return _memoryUsage; }
+  size_t getEntryCount() const { return _entries.size(); }
+  unsigned int getHits() const { return _hits; }
+  unsigned int getMisses() const { return _misses; }
+
+  void clear();
+  void resetCounters();
+
+  // looks up the values of the outputs for the time and the current
+  // values of the inputs. on a hit the cached values are written into
+  // the output ports and true is returned. on a miss the key is kept
+  // for the following store call.
+  bool fetch(double time, const std::vector<Port> & inputs, const std::vector<Port> & outputs);
+
+  // stores the current values of the outputs for the key of the last
+  // fetch which missed.
+  void store(const std::vector<Port> & outputs);
+
+  // stores the values of the outputs for the time and the values of the
+  // inputs, used by the prefetching worker threads on a cloned graph.
+  // the values are dropped if the generation is no longer current.
+  void insert(double time, const std::vector<Port> & inputs, const std::vector<Port> & outputs, unsigned int generation);
+
+  // the generation of the inserts, bumped by clear and cancelInserts
+  unsigned int getGeneration() const { return (unsigned int)_generation; }
+  // drops the values of all inserts still in flight
+  void cancelInserts();
+
+private:
+
+  struct Value {
+    FabricCore::RTVal rtVal;
+    std::vector<char> data;
+    bool isArray;
+  };
+
+  struct Entry {
+    double time;
+    uint64_t hash;
+    std::vector<char> inputs;
+    std::vector<Value> outputs;
+    size_t size;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+  static bool buildKey(double time, const std::vector<Port> & inputs, std::vector<char> & buffer, uint64_t & hash);
+  static void readOutputs(const std::vector<Port> & outputs, Entry & entry);
+  void insertEntry(Entry & entry, unsigned int generation);
+  void evict();
+
+  // the cache is filled by the prefetching threads as well
+  mutable MSpinLock _lock;
+
+  bool _enabled;
+  size_t _budget;
+  size_t _memoryUsage;
+  volatile int _generation;
+  unsigned int _hits;
+  unsigned int _misses;
+
+  // most recently used first
+  EntryList _entries;
+  std::map<uint64_t, EntryList::iterator> _entriesByHash;
+
+  bool _hasPendingKey;
+  double _pendingTime;
+  uint64_t _pendingHash;
+  std::vector<char> _pendingInputs;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "FabricSpliceInvalidationQueue.h"
+#include "plugin.h"
+
+#include <FabricSplice.h>
+
+#include <maya/MGlobal.h>
+#include <maya/MEventMessage.h>
+
+std::map<std::string, FabricSpliceInvalidationQueue::Entry> FabricSpliceInvalidationQueue::_plugs;
+MCallbackId FabricSpliceInvalidationQueue::_idleCallbackId = 0;
+bool FabricSpliceInvalidationQueue::_hasIdleCallback = false;
+MSpinLock FabricSpliceInvalidationQueue::_lock;
+
+void FabricSpliceInvalidationQueue::add(const MPlug & plug)
+{
+  if(plug.isNull())
+    return;
+  if(plug.attribute().isNull())
+    return;
+
+  // collapse elements, and children of elements, into the array plug
+  MPlug root = plug;
+  for(;;){
+    if(root.isElement())
+      root = root.array();
+    else if(root.isChild() && root.parent().isElement())
+      root = root.parent().array();
+    else
+      break;
+  }
+
+  // skip plugs of unresolved elements, containing [-1]
+  MString plugName = root.name();
+  if(plugName.indexW("[-1]") >= 0)
+    return;
+
+  Entry entry;
+  entry.node = MObjectHandle(root.node());
+  entry.plug = root;
+
+  _lock.lock();
+  _plugs.insert(std::pair<std::string, Entry>(plugName.asChar(), entry));
+  _lock.unlock();
+
+  if(mayaIsMainThread())
+    schedule();
+}
+
+void FabricSpliceInvalidationQueue::schedule()
+{
+  if(_hasIdleCallback || getPendingCount() == 0)
+    return;
+
+  MStatus status;
+  _idleCallbackId = MEventMessage::addEventCallback("idle", onIdle, NULL, &status);
+  _hasIdleCallback = status == MS::kSuccess;
+  if(!_hasIdleCallback)
+    flush();
+}
+
+void FabricSpliceInvalidationQueue::onIdle(void * clientData)
+{
+  // idle callbacks are invoked as long as they are registered
+  if(_hasIdleCallback){
+    MMessage::removeCallback(_idleCallbackId);
+    _hasIdleCallback = false;
+  }
+  flush();
+}
+
+void FabricSpliceInvalidationQueue::flush()
+{
+  std::map<std::string, Entry> plugs;
+  _lock.lock();
+  plugs.swap(_plugs);
+  _lock.unlock();
+
+  if(plugs.size() == 0)
+    return;
+
+  FabricSplice::Logging::AutoTimer timer("Maya::FabricSpliceInvalidationQueue::flush()");
+
+  // maya doesn't offer to dirty arbitrary plugs through the API, so all
+  // plugs are dirtied by a single command. the names are resolved again
+  // since the nodes might have been renamed in the meantime.
+  MString command("dgdirty");
+  unsigned int count = 0;
+  for(std::map<std::string, Entry>::iterator it = plugs.begin(); it != plugs.end(); ++it){
+    if(!it->second.node.isValid() || !it->second.node.isAlive())
+      continue;
+    command += " ";
+    command += it->second.plug.name();
+    count++;
+  }
+
+  if(count > 0)
+    MGlobal::executeCommand(command, false, false);
+}
+
+void FabricSpliceInvalidationQueue::clear()
+{
+  if(_hasIdleCallback){
+    MMessage::removeCallback(_idleCallbackId);
+    _hasIdleCallback = false;
+  }
+
+  _lock.lock();
+  _plugs.clear();
+  _lock.unlock();
+}
+
+unsigned int FabricSpliceInvalidationQueue::getPendingCount()
+{
+  _lock.lock();
+  unsigned int count = (unsigned int)_plugs.size();
+  _lock.unlock();
+  return count;
+}
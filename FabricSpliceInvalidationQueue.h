@@ -0,0 +1,47 @@
+#ifndef _CREATIONSPLICEINVALIDATIONQUEUE_H_
+#define _CREATIONSPLICEINVALIDATIONQUEUE_H_
+
+#include <maya/MPlug.h>
+#include <maya/MObjectHandle.h>
+#include <maya/MMessage.h>
+#include <maya/MSpinLock.h>
+
+#include <map>
+#include <string>
+
+// collects the plugs to be dirtied and dirties them all at once when
+// maya is idle. plugs are deduplicated and array elements are collapsed
+// into their array plug, so invalidating a node with large arrays
+// doesn't queue a command per element.
+class FabricSpliceInvalidationQueue {
+public:
+
+  static void add(const MPlug & plug);
+
+  // dirties all queued plugs right away
+  static void flush();
+  // drops all queued plugs, for unloading the plugin
+  static void clear();
+
+  // makes sure plugs queued on worker threads are flushed on the next
+  // idle, expected to be called on the main thread.
+  static void schedule();
+
+  static unsigned int getPendingCount();
+
+private:
+
+  struct Entry {
+    MObjectHandle node;
+    MPlug plug;
+  };
+
+  static void onIdle(void * clientData);
+
+  static std::map<std::string, Entry> _plugs;
+  static MCallbackId _idleCallbackId;
+  static bool _hasIdleCallback;
+  static MSpinLock _lock;
+};
+
+#endif
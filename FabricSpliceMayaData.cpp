@@ -1,37 +1,235 @@
 #include "FabricSpliceMayaData.h"
+#include "FabricSpliceBaseInterface.h"
+#include "FabricSplicePersistence.h"
 
 #include <maya/MGlobal.h>
 
+#include <string.h>
+
 const MTypeId FabricSpliceMayaData::id( 0x0011AE45 );
 const MString FabricSpliceMayaData::typeName( "FabricSpliceMayaData" );
 MString MFnFabricSpliceMayaData::classNameString ("MFnFabricSpliceMayaData") ;
 
 FabricSpliceMayaData::FabricSpliceMayaData(){
+  mDecodePending = false;
+  mPendingRawSize = 0;
 }
 
 FabricSpliceMayaData::~FabricSpliceMayaData(){
 }
 
+// the wrapped value is stored as the JSON of the RTVal along with its type,
+// compressed. ASCII files hold it base64 encoded in chunks of gChunkSize.
+static const char * gMagic = "FSMD";
+static const unsigned int gSchemaVersion = 1;
+static const size_t gChunkSize = 4096;
+
+static void writeUInt(std::ostream & out, uint64_t value, int bytes)
+{
+  for(int i = 0; i < bytes; ++i)
+    out.put((char)((value >> (i * 8)) & 0xff));
+}
+
+static bool readUInt(std::istream & in, uint64_t & value, int bytes)
+{
+  value = 0;
+  for(int i = 0; i < bytes; ++i){
+    int c = in.get();
+    if(c == EOF)
+      return false;
+    value |= (uint64_t)(uint8_t)c << (i * 8);
+  }
+  return true;
+}
+
+bool FabricSpliceMayaData::encodeValue(std::string & typeName, std::vector<char> & data, uint64_t & rawSize) const
+{
+  // a value which hasn't been decoded yet is written as read
+  if(mDecodePending){
+    typeName = mPendingTypeName;
+    data = mPendingData;
+    rawSize = mPendingRawSize;
+    return true;
+  }
+
+  typeName.clear();
+  data.clear();
+  rawSize = 0;
+  if(!mValue.isValid() || mValue.isInterface())
+    return false;
+
+  typeName = mValue.getTypeName().getStringCString();
+  if(mValue.isObject() && mValue.isNullObject())
+    return true;
+
+  std::string json = mValue.getJSON().getStringCString();
+  rawSize = json.length();
+  if(rawSize > 0)
+    FabricSplicePersistenceData::compress(json.c_str(), json.length(), data);
+  return true;
+}
+
+MStatus FabricSpliceMayaData::decodeValue() const{
+  MStatus stat;
+  MAYASPLICE_CATCH_BEGIN(&stat);
+
+  std::string typeName;
+  std::vector<char> data;
+  uint64_t rawSize = mPendingRawSize;
+  typeName.swap(mPendingTypeName);
+  data.swap(mPendingData);
+  mDecodePending = false;
+
+  mValue = FabricCore::RTVal();
+  if(typeName.length() == 0)
+    return MS::kSuccess;
+
+  std::vector<char> json;
+  if(rawSize > 0 && !FabricSplicePersistenceData::decompress(data.size() > 0 ? &data[0] : NULL, data.size(), (size_t)rawSize, json)){
+    mayaLogErrorFunc("FabricSpliceMayaData: Corrupt data of type '"+MString(typeName.c_str())+"'.");
+    return MS::kFailure;
+  }
+
+  FabricCore::RTVal value = FabricSplice::constructRTVal(typeName.c_str());
+  if(value.isObject()){
+    if(json.size() == 0){
+      mValue = value;
+      return MS::kSuccess;
+    }
+    value = FabricSplice::constructObjectRTVal(typeName.c_str());
+  }
+  json.push_back('\0');
+  value.setJSON(FabricSplice::constructStringRTVal(&json[0]));
+  mValue = value;
+
+  MAYASPLICE_CATCH_END(&stat);
+  return stat;
+}
+
 MStatus FabricSpliceMayaData::readASCII( const MArgList & argList, unsigned & index ){
+  // empty data of scenes saved before the data was stored
+  if(index >= argList.length())
     return MS::kSuccess;
+
+  MStatus stat;
+  MString magic = argList.asString(index++, &stat);
+  if(stat != MS::kSuccess || magic != gMagic)
+    return MS::kFailure;
+
+  unsigned int version = argList.asInt(index++, &stat);
+  if(stat != MS::kSuccess || version > gSchemaVersion)
+    return MS::kFailure;
+
+  std::string typeName = argList.asString(index++, &stat).asChar();
+  uint64_t rawSize = (uint64_t)argList.asDouble(index++, &stat);
+  unsigned int chunkCount = argList.asInt(index++, &stat);
+  if(stat != MS::kSuccess)
+    return MS::kFailure;
+
+  std::string encoded;
+  for(unsigned int i = 0; i < chunkCount; ++i){
+    MString chunk = argList.asString(index++, &stat);
+    if(stat != MS::kSuccess)
+      return MS::kFailure;
+    encoded += chunk.asChar();
+  }
+
+  std::vector<char> data;
+  if(!FabricSplicePersistenceData::decodeBase64(encoded.c_str(), encoded.length(), data))
+    return MS::kFailure;
+
+  mValue = FabricCore::RTVal();
+  mPendingTypeName = typeName;
+  mPendingData.swap(data);
+  mPendingRawSize = rawSize;
+  mDecodePending = true;
+  return MS::kSuccess;
 }
 
 MStatus FabricSpliceMayaData::readBinary( std::istream & in, unsigned length ){
+  if(length == 0)
     return MS::kSuccess;
-    
+
+  char magic[4];
+  in.read(magic, 4);
+  if(!in.good() || strncmp(magic, gMagic, 4) != 0)
+    return MS::kFailure;
+
+  uint64_t version, typeNameLength, rawSize, storedSize;
+  if(!readUInt(in, version, 4) || version > gSchemaVersion)
+    return MS::kFailure;
+  if(!readUInt(in, typeNameLength, 4) || typeNameLength > length)
+    return MS::kFailure;
+  std::string typeName((size_t)typeNameLength, '\0');
+  if(typeNameLength > 0)
+    in.read(&typeName[0], typeNameLength);
+  if(!readUInt(in, rawSize, 8) || !readUInt(in, storedSize, 8) || storedSize > length)
+    return MS::kFailure;
+  std::vector<char> data((size_t)storedSize);
+  if(storedSize > 0)
+    in.read(&data[0], storedSize);
+  if(in.fail())
+    return MS::kFailure;
+
+  mValue = FabricCore::RTVal();
+  mPendingTypeName = typeName;
+  mPendingData.swap(data);
+  mPendingRawSize = rawSize;
+  mDecodePending = true;
+  return MS::kSuccess;
 }
 
 MStatus FabricSpliceMayaData::writeASCII( std::ostream & out ){
-  return MS::kSuccess;
+  MStatus stat;
+  MAYASPLICE_CATCH_BEGIN(&stat);
+
+  std::string typeName;
+  std::vector<char> data;
+  uint64_t rawSize;
+  encodeValue(typeName, data, rawSize);
+
+  std::string encoded;
+  FabricSplicePersistenceData::appendBase64(data, encoded);
+  size_t chunkCount = (encoded.length() + gChunkSize - 1) / gChunkSize;
+
+  out << "\"" << gMagic << "\" " << gSchemaVersion << " \"" << typeName << "\" " << rawSize << " " << chunkCount;
+  for(size_t i = 0; i < chunkCount; ++i)
+    out << " \"" << encoded.substr(i * gChunkSize, gChunkSize) << "\"";
+  out << " ";
+
+  MAYASPLICE_CATCH_END(&stat);
+  return stat;
 }
 
 MStatus FabricSpliceMayaData::writeBinary( std::ostream & out ){
-  return MS::kSuccess;
+  MStatus stat;
+  MAYASPLICE_CATCH_BEGIN(&stat);
+
+  std::string typeName;
+  std::vector<char> data;
+  uint64_t rawSize;
+  encodeValue(typeName, data, rawSize);
+
+  out.write(gMagic, 4);
+  writeUInt(out, gSchemaVersion, 4);
+  writeUInt(out, typeName.length(), 4);
+  out.write(typeName.c_str(), typeName.length());
+  writeUInt(out, rawSize, 8);
+  writeUInt(out, data.size(), 8);
+  if(data.size() > 0)
+    out.write(&data[0], data.size());
+
+  MAYASPLICE_CATCH_END(&stat);
+  return stat;
 }
 
 void FabricSpliceMayaData::copy ( const MPxData & other ){
   FabricSpliceMayaData &otherSpliceData = ( FabricSpliceMayaData &)other;
   mValue = otherSpliceData.mValue;
+  mDecodePending = otherSpliceData.mDecodePending;
+  mPendingTypeName = otherSpliceData.mPendingTypeName;
+  mPendingData = otherSpliceData.mPendingData;
+  mPendingRawSize = otherSpliceData.mPendingRawSize;
 }
 
 MTypeId FabricSpliceMayaData::typeId() const{
@@ -48,9 +246,14 @@ void * FabricSpliceMayaData::creator(){
 
 void FabricSpliceMayaData::setRTVal(const FabricCore::RTVal &value){
   mValue = value;
+  mDecodePending = false;
+  mPendingTypeName.clear();
+  mPendingData.clear();
 }
 
 FabricCore::RTVal FabricSpliceMayaData::getRTVal() const{
+  if(mDecodePending)
+    decodeValue();
   return mValue;
 }
 
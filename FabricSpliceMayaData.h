@@ -4,6 +4,10 @@
 
 #include <istream>
 #include <ostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
 
 #include <maya/MPxData.h>
 #include <maya/MTypeId.h>
@@ -38,7 +42,17 @@ public:
   FabricCore::RTVal getRTVal() const;
 
 private:
-  FabricCore::RTVal mValue;
+  bool encodeValue(std::string & typeName, std::vector<char> & data, uint64_t & rawSize) const;
+  MStatus decodeValue() const;
+
+  mutable FabricCore::RTVal mValue;
+
+  // the value read from a file is only decoded once requested, as the
+  // extensions defining its type are loaded after the file is read
+  mutable bool mDecodePending;
+  mutable std::string mPendingTypeName;
+  mutable std::vector<char> mPendingData;
+  mutable uint64_t mPendingRawSize;
 };
 
 class  MFnFabricSpliceMayaData : public MFnPluginData {
@@ -11,6 +11,7 @@
 #include <maya/MFnMesh.h>
 #include <maya/MItMeshEdge.h>
 #include <maya/MItMeshPolygon.h>
+#include <maya/MArrayDataBuilder.h>
 
 MTypeId FabricSpliceMayaDeformer::id(0x0011AE42);
 MObject FabricSpliceMayaDeformer::saveData;
@@ -19,7 +20,7 @@ MObject FabricSpliceMayaDeformer::evalID;
 FabricSpliceMayaDeformer::FabricSpliceMayaDeformer()
 : FabricSpliceBaseInterface()
 {
-  mGeometryInitialized = 0;
+  mFloatPointsSupported = -1;
 }
 
 FabricSpliceMayaDeformer::~FabricSpliceMayaDeformer()
@@ -55,119 +56,369 @@ MStatus FabricSpliceMayaDeformer::initialize(){
   return MS::kSuccess;
 }
 
-MStatus FabricSpliceMayaDeformer::deform(MDataBlock& block, MItGeometry& iter, const MMatrix&, unsigned int multiIndex){
+MStatus FabricSpliceMayaDeformer::compute(const MPlug& plug, MDataBlock& data){
+  if(plug.attribute() != outputGeom)
+    return MPxDeformerNode::compute(plug, data);
+
   MStatus stat;
   MAYASPLICE_CATCH_BEGIN(&stat);
 
-  FabricSplice::Logging::AutoTimer timer("Maya::deform()");
+  FabricSplice::Logging::AutoTimer timer("Maya::deformBatched()");
+
+  EvaluationScope scope(this);
+  if(scope.reentered())
+    return MStatus::kSuccess;
+
+  restoreDeferredPersistenceData(true);
 
   if(!_spliceGraph.checkErrors()){
     return MStatus::kFailure; // avoid evaluating on errors
   }
 
+  // all input geometries are gathered into their meshN ports, the graph
+  // is evaluated once and the results are scattered to the outputs,
+  // instead of evaluating the whole graph per geometry in deform. this
+  // replaces MPxDeformerNode::compute, so deform is never called.
+  MArrayDataHandle inputArray = data.inputArrayValue(input);
+  MArrayDataHandle outputArray = data.outputArrayValue(outputGeom);
+
+  std::vector<unsigned int> multiIndices;
+  std::vector<unsigned int> groupIds;
+  for(unsigned int i = 0; i < inputArray.elementCount(); ++i){
+    inputArray.jumpToArrayElement(i);
+    multiIndices.push_back(inputArray.elementIndex());
+    groupIds.push_back(inputArray.inputValue().child(groupId).asLong());
+  }
+
+  // make sure there is an output element for each input
+  MArrayDataBuilder outputBuilder = outputArray.builder();
+  for(size_t i = 0; i < multiIndices.size(); ++i)
+    outputBuilder.addElement(multiIndices[i]);
+  outputArray.set(outputBuilder);
+
+  std::vector<MDataHandle> outputHandles(multiIndices.size());
+  std::vector<MItGeometry*> iterators(multiIndices.size(), (MItGeometry*)NULL);
+  std::vector<GeometryEvaluation> evaluations(multiIndices.size());
+  std::vector<bool> gathered(multiIndices.size(), false);
+
+  for(size_t i = 0; i < multiIndices.size(); ++i){
+    inputArray.jumpToElement(multiIndices[i]);
+    outputArray.jumpToElement(multiIndices[i]);
+    outputHandles[i] = outputArray.outputValue();
+    outputHandles[i].copy(inputArray.inputValue().child(inputGeom));
+
+    if(!initializeGeometry(multiIndices[i], data)){
+      stat = MStatus::kFailure;
+      break;
+    }
+  }
+
+  // with a zero envelope or a node state other than normal, like
+  // HasNoEffect, the outputs are just the copied inputs
+  bool enabled = data.inputValue(envelope).asFloat() != 0.0f && data.inputValue(state).asShort() == 0;
+
+  // the dirty inputs are tracked for the normal context only
+  bool isNormalContext = data.context().isNormal();
+
+  if(stat == MStatus::kSuccess && enabled){
+    // without the dirty inputs reported by maya all inputs are transfered
+    if(!isDirtyTracked(data.context()))
+      invalidateEvaluation();
+    transferInputValuesToSplice(data);
+
+    for(size_t i = 0; i < multiIndices.size(); ++i){
+      iterators[i] = new MItGeometry(outputHandles[i], groupIds[i], false);
+      gathered[i] = gatherGeometry(data, *iterators[i], outputHandles[i].data(), multiIndices[i], evaluations[i]);
+    }
+
+    evaluate(getEvaluationTime(data));
+
+    for(size_t i = 0; i < multiIndices.size(); ++i){
+      if(gathered[i])
+        scatterGeometry(data, *iterators[i], evaluations[i]);
+    }
+
+    transferOutputValuesToMaya(data, true);
+    if(!isNormalContext)
+      invalidateEvaluation();
+  }
+
+  for(size_t i = 0; i < outputHandles.size(); ++i)
+    outputHandles[i].setClean();
+
+  for(size_t i = 0; i < iterators.size(); ++i){
+    if(iterators[i])
+      delete(iterators[i]);
+  }
+
+  outputArray.setAllClean();
+  data.setClean(plug);
+
+  MAYASPLICE_CATCH_END(&stat);
+
+  return stat;
+}
+
+bool FabricSpliceMayaDeformer::initializeGeometry(unsigned int multiIndex, MDataBlock &data){
+  GeometryState & state = mGeometries[multiIndex];
+  if(state.initialized > 0)
+    return true;
+
+  MString meshIdStr;
+  meshIdStr.set(multiIndex);
+
+  MPlug inputPlug(thisMObject(), input);
+  MPlug meshPlug = inputPlug.elementByLogicalIndex(multiIndex).child(inputGeom);
+
+  state.initialized = initializePolygonMeshPorts(meshIdStr, meshPlug, data);
+  return state.initialized >= 0;
+}
+
+bool FabricSpliceMayaDeformer::hasPaintedWeights(MDataBlock &data, unsigned int multiIndex){
+  MArrayDataHandle weightLists = data.inputArrayValue(weightList);
+  if(weightLists.jumpToElement(multiIndex) != MS::kSuccess)
+    return false;
+  MArrayDataHandle weightsHandle(weightLists.inputValue().child(weights));
+  return weightsHandle.elementCount() > 0;
+}
+
+bool FabricSpliceMayaDeformer::gatherGeometry(MDataBlock &data, MItGeometry &iter, MObject geometry, unsigned int multiIndex, GeometryEvaluation &evaluation){
+  evaluation.multiIndex = multiIndex;
+  evaluation.useFloatPoints = false;
+  evaluation.sparse = false;
+  evaluation.useChangedMask = false;
+  evaluation.envelope = data.inputValue(envelope).asFloat();
+  evaluation.weighted = evaluation.envelope != 1.0f || hasPaintedWeights(data, multiIndex);
+
   MString meshIdStr;
   meshIdStr.set(multiIndex);
 
-  if(mGeometryInitialized < 1){
-    MArrayDataHandle inputArray = block.inputArrayValue(input);
-    for(int i = 0; i < inputArray.elementCount(); ++i){
-      MPlug inputPlug(thisMObject(), input);
-      MPlug inputElementPlug = inputPlug.elementByPhysicalIndex(multiIndex);
-      MPlug meshPlug = inputElementPlug.child(inputGeom);
+  // sparse mode, the operator works on the member points only
+  evaluation.pointsPort = _spliceGraph.getDGPort(("mesh" + meshIdStr + "_points").asChar());
+  if(evaluation.pointsPort.isValid() && evaluation.pointsPort.isArray() && evaluation.pointsPort.getMode() == FabricSplice::Port_Mode_IO){
+    if(evaluation.pointsPort.getDataType() != std::string("Vec3")){
+      mayaLogErrorFunc("FabricSpliceMayaDeformer: Port mesh" + meshIdStr + "_points has to be of type Vec3[].");
+      return false;
+    }
+    return gatherSparseGeometry(iter, evaluation);
+  }
 
-      mGeometryInitialized = initializePolygonMeshPorts(meshIdStr, meshPlug, block);
-      if(mGeometryInitialized < 0){
-        return MStatus::kFailure;
+  FabricSplice::DGPort port = _spliceGraph.getDGPort(("mesh" + meshIdStr).asChar());
+  if(!port.isValid() || port.getMode() != FabricSplice::Port_Mode_IO)
+    return false;
+  evaluation.rtMesh = port.getRTVal();
+  if(!evaluation.rtMesh.isValid() || evaluation.rtMesh.isNullObject())
+    return false;
+
+  GeometryState & state = mGeometries[multiIndex];
+
+  // for meshes the points are read straight from the output mesh as
+  // Float32 and written back through MFnMesh, one copy each way. this
+  // needs all of the mesh's points to be members of the deformer.
+  if(mFloatPointsSupported != 0 && !geometry.isNull() && geometry.hasFn(MFn::kMesh)){
+    MFnMesh mesh(geometry);
+    MStatus rawStatus;
+    const float * rawPoints = mesh.getRawPoints(&rawStatus);
+    if(rawStatus == MS::kSuccess && mesh.numVertices() == iter.count()){
+      try
+      {
+        std::vector<FabricCore::RTVal> args(2);
+        args[0] = FabricSplice::constructExternalArrayRTVal("Float32", mesh.numVertices() * 3, (void*)rawPoints);
+        args[1] = FabricSplice::constructUInt32RTVal(3); // components
+        evaluation.rtMesh.callMethod("", "setPointsFromExternalArray", 2, &args[0]);
+        evaluation.meshObj = geometry;
+        evaluation.useFloatPoints = true;
+        mFloatPointsSupported = 1;
+      }
+      catch(FabricCore::Exception e)
+      {
+        // older PolygonMesh without the Float32 accessors, use Float64 from now on
+        if(mFloatPointsSupported == 1)
+        {
+          mayaLogErrorFunc(e.getDesc_cstr());
+          return false;
+        }
+        mFloatPointsSupported = 0;
       }
     }
   }
 
-  transferInputValuesToSplice(block);
+  if(!evaluation.useFloatPoints){
+    iter.allPositions(state.points);
 
-  FabricSplice::DGPort port = _spliceGraph.getDGPort(("mesh" + meshIdStr).asChar());
-  if(port.getMode() != FabricSplice::Port_Mode_IO)
-    return MStatus::kSuccess;
-  FabricCore::RTVal rtMesh = port.getRTVal();
-  if(!rtMesh.isValid() || rtMesh.isNullObject())
-    return MStatus::kSuccess;
+    try
+    {
+      std::vector<FabricCore::RTVal> args(2);
+      args[0] = FabricSplice::constructExternalArrayRTVal("Float64", state.points.length() * 4, &state.points[0]);
+      args[1] = FabricSplice::constructUInt32RTVal(4); // components
+      evaluation.rtMesh.callMethod("", "setPointsFromExternalArray_d", 2, &args[0]);
+    }
+    catch(FabricCore::Exception e)
+    {
+      mayaLogErrorFunc(e.getDesc_cstr());
+      return false;
+    }
 
-  MPointArray mayaPoints;
-  iter.allPositions(mayaPoints);
-
-  // MPlug inputPlug(thisMObject(), input);
-  // MPlug inputElementPlug = inputPlug.elementByPhysicalIndex(multiIndex);
-  // MPlug meshPlug = inputElementPlug.child(inputGeom);
-  // MDataHandle handle = block.outputValue(meshPlug);
-  // MObject meshObj = handle.asMesh();
-  // MFnMesh mesh(meshObj);
-
-  // MFloatVectorArray mayaFnormals;
-  // mesh.getNormals(mayaFnormals);
-  // MIntArray mayaCounts, mayaIndices;
-  // mesh.getNormalIds(mayaCounts, mayaIndices);
-
-  // MVectorArray mayaNormals;
-  // mayaNormals.setLength(mayaIndices.length());
-  // for(unsigned int i=0;i<mayaIndices.length();i++)
-  // {
-  //   mayaNormals[i].x = mayaFnormals[mayaIndices[i]].x;
-  //   mayaNormals[i].y = mayaFnormals[mayaIndices[i]].y;
-  //   mayaNormals[i].z = mayaFnormals[mayaIndices[i]].z;
-  // }
+    // the weights are looked up by component index
+    if(evaluation.weighted){
+      evaluation.indices.setLength(state.points.length());
+      unsigned int k = 0;
+      for(iter.reset(); !iter.isDone() && k < evaluation.indices.length(); iter.next(), k++)
+        evaluation.indices[k] = iter.index();
+    }
+  }
 
-  try
-  {
-    std::vector<FabricCore::RTVal> args(2);
-    args[0] = FabricSplice::constructExternalArrayRTVal("Float64", mayaPoints.length() * 4, &mayaPoints[0]);
-    args[1] = FabricSplice::constructUInt32RTVal(4); // components
-    rtMesh.callMethod("", "setPointsFromExternalArray_d", 2, &args[0]);
+  port.setRTVal(evaluation.rtMesh);
+  return true;
+}
+
+bool FabricSpliceMayaDeformer::gatherSparseGeometry(MItGeometry &iter, GeometryEvaluation &evaluation){
+  GeometryState & state = mGeometries[evaluation.multiIndex];
 
-    // FabricCore::RTVal normalsVar = 
-    //   FabricSplice::constructExternalArrayRTVal("Float64", mayaNormals.length() * 3, &mayaNormals[0]);
-    // rtMesh.callMethod("", "setNormalsFromFloat64Array", 1, &normalsVar);
+  MString meshIdStr;
+  meshIdStr.set(evaluation.multiIndex);
+
+  unsigned int count = iter.count();
+  evaluation.sparse = true;
+  evaluation.indices.setLength(count);
+  state.sparsePoints.resize(count * 3);
+
+  unsigned int k = 0;
+  for(iter.reset(); !iter.isDone() && k < count; iter.next(), k++){
+    MPoint pos = iter.position();
+    evaluation.indices[k] = iter.index();
+    state.sparsePoints[k * 3 + 0] = (float)pos.x;
+    state.sparsePoints[k * 3 + 1] = (float)pos.y;
+    state.sparsePoints[k * 3 + 2] = (float)pos.z;
   }
-  catch(FabricCore::Exception e)
-  {
-    mayaLogErrorFunc(e.getDesc_cstr());
-    return MStatus::kSuccess;
+
+  evaluation.pointsPort.setArrayData(count > 0 ? &state.sparsePoints[0] : NULL, count * 3 * sizeof(float));
+
+  // the component indices are optional, an operator which only offsets
+  // the points doesn't need them
+  FabricSplice::DGPort indicesPort = _spliceGraph.getDGPort(("mesh" + meshIdStr + "_indices").asChar());
+  if(indicesPort.isValid() && indicesPort.isArray()){
+    std::string dataType = indicesPort.getDataType();
+    if(dataType != "UInt32" && dataType != "Integer" && dataType != "SInt32" && dataType != "Index" && dataType != "Size"){
+      mayaLogErrorFunc("FabricSpliceMayaDeformer: Port mesh" + meshIdStr + "_indices has to be of type UInt32[] or Integer[].");
+      return false;
+    }
+    indicesPort.setArrayData(count > 0 ? &evaluation.indices[0] : NULL, count * sizeof(int));
+  }
+
+  // an optional Boolean[] mask of the points moved by the operator
+  evaluation.changedPort = _spliceGraph.getDGPort(("mesh" + meshIdStr + "_changed").asChar());
+  evaluation.useChangedMask = evaluation.changedPort.isValid();
+  if(evaluation.useChangedMask){
+    if(!evaluation.changedPort.isArray() || evaluation.changedPort.getDataType() != std::string("Boolean")){
+      mayaLogErrorFunc("FabricSpliceMayaDeformer: Port mesh" + meshIdStr + "_changed has to be of type Boolean[].");
+      evaluation.useChangedMask = false;
+    }
+  }
+
+  return true;
+}
+
+void FabricSpliceMayaDeformer::scatterGeometry(MDataBlock &data, MItGeometry &iter, GeometryEvaluation &evaluation){
+  if(evaluation.sparse){
+    scatterSparseGeometry(data, iter, evaluation);
+    return;
   }
-  port.setRTVal(rtMesh);
 
-  evaluate();
+  GeometryState & state = mGeometries[evaluation.multiIndex];
 
   try
   {
-    std::vector<FabricCore::RTVal> args(2);
-    args[0] = FabricSplice::constructExternalArrayRTVal("Float64", mayaPoints.length() * 4, &mayaPoints[0]);
-    args[1] = FabricSplice::constructUInt32RTVal(4); // components
-    rtMesh.callMethod("", "getPointsAsExternalArray_d", 2, &args[0]);
-
-    // FabricCore::RTVal normalsVar = 
-    //     FabricSplice::constructExternalArrayRTVal("Float64", mayaNormals.length() * 3, &mayaNormals[0]);
-    // rtMesh.callMethod("", "getNormalsAsFloat64Array", 1, &normalsVar);
-
-    // for(unsigned int i=0;i<mayaIndices.length();i++)
-    // {
-    //   mayaFnormals[mayaIndices[i]].x = mayaNormals[i].x;
-    //   mayaFnormals[mayaIndices[i]].y = mayaNormals[i].y;
-    //   mayaFnormals[mayaIndices[i]].z = mayaNormals[i].z;
-    // }
+    if(evaluation.useFloatPoints){
+      MFnMesh mesh(evaluation.meshObj);
+      state.floatPoints.setLength(mesh.numVertices());
+      std::vector<FabricCore::RTVal> args(2);
+      args[0] = FabricSplice::constructExternalArrayRTVal("Float32", state.floatPoints.length() * 4, &state.floatPoints[0]);
+      args[1] = FabricSplice::constructUInt32RTVal(4); // components
+      evaluation.rtMesh.callMethod("", "getPointsAsExternalArray", 2, &args[0]);
+
+      // blend with the points still in the mesh, all of them are members
+      if(evaluation.weighted){
+        const float * rawPoints = mesh.getRawPoints(NULL);
+        for(unsigned int i = 0; i < state.floatPoints.length(); i++){
+          float weight = evaluation.envelope * weightValue(data, evaluation.multiIndex, i);
+          MFloatPoint & pos = state.floatPoints[i];
+          pos.x = rawPoints[i * 3 + 0] + (pos.x - rawPoints[i * 3 + 0]) * weight;
+          pos.y = rawPoints[i * 3 + 1] + (pos.y - rawPoints[i * 3 + 1]) * weight;
+          pos.z = rawPoints[i * 3 + 2] + (pos.z - rawPoints[i * 3 + 2]) * weight;
+        }
+      }
+      mesh.setPoints(state.floatPoints);
+    }
+    else{
+      MPointArray original;
+      if(evaluation.weighted)
+        original = state.points;
+
+      std::vector<FabricCore::RTVal> args(2);
+      args[0] = FabricSplice::constructExternalArrayRTVal("Float64", state.points.length() * 4, &state.points[0]);
+      args[1] = FabricSplice::constructUInt32RTVal(4); // components
+      evaluation.rtMesh.callMethod("", "getPointsAsExternalArray_d", 2, &args[0]);
+
+      if(evaluation.weighted){
+        for(unsigned int i = 0; i < state.points.length() && i < evaluation.indices.length(); i++){
+          float weight = evaluation.envelope * weightValue(data, evaluation.multiIndex, evaluation.indices[i]);
+          state.points[i] = original[i] + (state.points[i] - original[i]) * weight;
+        }
+      }
+      iter.setAllPositions(state.points);
+    }
   }
   catch(FabricCore::Exception e)
   {
     mayaLogErrorFunc(e.getDesc_cstr());
-    return MStatus::kSuccess;
   }
+}
 
-  iter.setAllPositions(mayaPoints);
-  // mesh.setNormals(mayaFnormals);
-  transferOutputValuesToMaya(block, true);
+void FabricSpliceMayaDeformer::scatterSparseGeometry(MDataBlock &data, MItGeometry &iter, GeometryEvaluation &evaluation){
+  GeometryState & state = mGeometries[evaluation.multiIndex];
 
-  MAYASPLICE_CATCH_END(&stat);
-  
-  return stat;
+  unsigned int count = evaluation.indices.length();
+  if(evaluation.pointsPort.getArrayCount() != count){
+    MString meshIdStr;
+    meshIdStr.set(evaluation.multiIndex);
+    mayaLogErrorFunc("FabricSpliceMayaDeformer: The operator changed the size of port mesh" + meshIdStr + "_points.");
+    return;
+  }
+  if(count == 0)
+    return;
+
+  evaluation.pointsPort.getArrayData(&state.sparsePoints[0], count * 3 * sizeof(float));
+
+  // without a mask all of the member points are written back
+  std::vector<char> changed;
+  if(evaluation.useChangedMask && evaluation.changedPort.getArrayCount() == count){
+    changed.resize(count);
+    evaluation.changedPort.getArrayData(&changed[0], count * sizeof(char));
+  }
+
+  unsigned int k = 0;
+  for(iter.reset(); !iter.isDone() && k < count; iter.next(), k++){
+    if(changed.size() > 0 && !changed[k])
+      continue;
+
+    MPoint pos(state.sparsePoints[k * 3 + 0], state.sparsePoints[k * 3 + 1], state.sparsePoints[k * 3 + 2]);
+    if(evaluation.weighted){
+      float weight = evaluation.envelope * weightValue(data, evaluation.multiIndex, evaluation.indices[k]);
+      MPoint original = iter.position();
+      pos = original + (pos - original) * weight;
+    }
+    iter.setPosition(pos);
+  }
 }
 
+#if _SPLICE_MAYA_VERSION >= 2016
+MStatus FabricSpliceMayaDeformer::preEvaluation(const MDGContext& context, const MEvaluationNode& evaluationNode){
+  FabricSpliceBaseInterface::preEvaluation(context, evaluationNode);
+  return MPxDeformerNode::preEvaluation(context, evaluationNode);
+}
+#endif
+
 MStatus FabricSpliceMayaDeformer::setDependentsDirty(MPlug const &inPlug, MPlugArray &affectedPlugs){
   MStatus stat;
   MAYASPLICE_CATCH_BEGIN(&stat);
@@ -197,12 +448,9 @@ void FabricSpliceMayaDeformer::invalidateNode()
   MPlug output = thisNode.findPlug("outputGeometry");
   invalidatePlug(output);
 
-  for(int i = 0; i < output.numElements(); ++i){
-    MPlug plug = output.elementByPhysicalIndex(i);
-    invalidatePlug(plug);
-  }
-
-  mGeometryInitialized = false;
+  // the ports might have changed, so all geometries need to be initialized again
+  for(std::map<unsigned int, GeometryState>::iterator it = mGeometries.begin(); it != mGeometries.end(); ++it)
+    it->second.initialized = 0;
 }
 
 MStatus FabricSpliceMayaDeformer::shouldSave(const MPlug &plug, bool &isSaving){
@@ -8,6 +8,12 @@
 #include <maya/MPxDeformerNode.h> 
 #include <maya/MTypeId.h> 
 #include <maya/MItGeometry.h>
+#include <maya/MPointArray.h>
+#include <maya/MFloatPointArray.h>
+#include <maya/MIntArray.h>
+
+#include <map>
+#include <vector>
 
 class FabricSpliceMayaDeformer: public MPxDeformerNode, public FabricSpliceBaseInterface{
 public:
@@ -22,7 +28,12 @@ public:
   virtual MObject getThisMObject() { return thisMObject(); }
   virtual MPlug getSaveDataPlug() { return MPlug(thisMObject(), saveData); }
 
-  MStatus deform(MDataBlock& block, MItGeometry& iter, const MMatrix&, unsigned int multiIndex);
+  MStatus compute(const MPlug& plug, MDataBlock& data);
+#if _SPLICE_MAYA_VERSION >= 2016
+  // independent splice nodes can be evaluated concurrently
+  SchedulingType schedulingType() const { return mayaParallelEvaluationEnabled() ? kParallel : kGloballySerial; }
+  MStatus preEvaluation(const MDGContext& context, const MEvaluationNode& evaluationNode);
+#endif
   MStatus setDependentsDirty(MPlug const &inPlug, MPlugArray &affectedPlugs);
   MStatus shouldSave(const MPlug &plug, bool &isSaving);
   void copyInternalData(MPxNode *node);
@@ -37,8 +48,43 @@ protected:
 
 private:
   int initializePolygonMeshPorts(MString &meshId, MPlug &meshPlug, MDataBlock &data);
-  // void initializeGeometry(MObject &meshObj);
-  int mGeometryInitialized;
+
+  // the state of each geometry, kept across evaluations per multiIndex
+  // so that compute doesn't allocate per geometry per frame
+  struct GeometryState {
+    GeometryState() : initialized(0) {}
+    int initialized;
+    MPointArray points;
+    MFloatPointArray floatPoints;
+    std::vector<float> sparsePoints;
+  };
+  std::map<unsigned int, GeometryState> mGeometries;
+
+  // a geometry gathered into its meshN port for a single evaluation.
+  // in sparse mode only the member points are sent to the meshN_points
+  // port, along with their component indices in meshN_indices.
+  struct GeometryEvaluation {
+    unsigned int multiIndex;
+    FabricCore::RTVal rtMesh;
+    MObject meshObj;
+    bool useFloatPoints;
+    bool sparse;
+    FabricSplice::DGPort pointsPort;
+    FabricSplice::DGPort changedPort;
+    bool useChangedMask;
+    MIntArray indices;
+    float envelope;
+    bool weighted;
+  };
+  bool initializeGeometry(unsigned int multiIndex, MDataBlock &data);
+  bool gatherGeometry(MDataBlock &data, MItGeometry &iter, MObject geometry, unsigned int multiIndex, GeometryEvaluation &evaluation);
+  bool gatherSparseGeometry(MItGeometry &iter, GeometryEvaluation &evaluation);
+  void scatterGeometry(MDataBlock &data, MItGeometry &iter, GeometryEvaluation &evaluation);
+  void scatterSparseGeometry(MDataBlock &data, MItGeometry &iter, GeometryEvaluation &evaluation);
+  bool hasPaintedWeights(MDataBlock &data, unsigned int multiIndex);
+
+  // whether the KL mesh supports the Float32 point accessors, -1 if unknown
+  int mFloatPointsSupported;
 };
 
 #endif
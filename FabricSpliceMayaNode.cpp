@@ -56,19 +56,55 @@ MStatus FabricSpliceMayaNode::compute(const MPlug& plug, MDataBlock& data){
 
   FabricSplice::Logging::AutoTimer timer("Maya::compute()");
 
+  EvaluationScope scope(this);
+  if(scope.reentered())
+    return MStatus::kSuccess;
+
+  restoreDeferredPersistenceData(true);
+
   if(!_spliceGraph.checkErrors()){
     return MStatus::kFailure; // avoid evaluating on errors
   }
 
-  transferInputValuesToSplice(data);
-  evaluate();
-  transferOutputValuesToMaya(data);
+  MTime time = getEvaluationTime(data);
+
+  // the dirty state tracks the normal context only, so evaluations at
+  // another time transfer all inputs and outputs and leave everything
+  // dirty for the next normal evaluation.
+  if(!data.context().isNormal()){
+    invalidateEvaluation();
+    transferInputValuesToSplice(data);
+    evaluateCached(time, false);
+    transferOutputValuesToMaya(data);
+    invalidateEvaluation();
+  }
+  else{
+    // only evaluate once per change of the inputs, the other
+    // outputs are converted once maya pulls them. this relies on maya
+    // reporting the dirty inputs, otherwise all of them are transfered.
+    if(!isDirtyTracked(data.context()))
+      invalidateEvaluation();
+    if(requiresEvaluation()){
+      transferInputValuesToSplice(data);
+      evaluateCached(time);
+    }
+
+    if(!transferOutputValueToMaya(plug, data))
+      transferOutputValuesToMaya(data);
+  }
 
   MAYASPLICE_CATCH_END(&stat);
 
   return stat;
 }
 
+#if _SPLICE_MAYA_VERSION >= 2016
+MStatus FabricSpliceMayaNode::preEvaluation(const MDGContext& context, const MEvaluationNode& evaluationNode){
+  FabricSpliceBaseInterface::preEvaluation(context, evaluationNode);
+  return MS::kSuccess;
+}
+#endif
+
 MStatus FabricSpliceMayaNode::setDependentsDirty(MPlug const &inPlug, MPlugArray &affectedPlugs){
   MStatus stat;
   MAYASPLICE_CATCH_BEGIN(&stat);
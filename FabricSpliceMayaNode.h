@@ -26,6 +26,11 @@ public:
   virtual MPlug getSaveDataPlug() { return MPlug(thisMObject(), saveData); }
 
   MStatus compute(const MPlug& plug, MDataBlock& data);
+#if _SPLICE_MAYA_VERSION >= 2016
+  // independent splice nodes can be evaluated concurrently
+  SchedulingType schedulingType() const { return mayaParallelEvaluationEnabled() ? kParallel : kGloballySerial; }
+  MStatus preEvaluation(const MDGContext& context, const MEvaluationNode& evaluationNode);
+#endif
   MStatus setDependentsDirty(MPlug const &inPlug, MPlugArray &affectedPlugs);
   MStatus shouldSave(const MPlug &plug, bool &isSaving);
   void copyInternalData(MPxNode *node);
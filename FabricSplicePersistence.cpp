@@ -0,0 +1,727 @@
+#include "FabricSplicePersistence.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// the prefix can't start a JSON document, so both encodings can be told apart
+static const char * gBinaryPrefix = "#FSPB:";
+// version 2 adds sections made of structs, older data is still written as version 1
+static const uint32_t gBinaryVersion = 2;
+static const char * gSectionKey = "__spliceSection__";
+// the fields of a section made of structs, such as Vec3[] or Mat44[]
+static const char * gSectionFieldsKey = "__spliceFields__";
+
+// shorter arrays stay in the layout
+static const uint32_t gMinSectionElements = 16;
+
+// the default bound of the decoded data cache, in MB
+static const size_t gDefaultCacheSize = 64;
+
+static size_t readCacheBudget()
+{
+  const char * size = getenv("FABRIC_SPLICE_PERSISTENCE_CACHE_SIZE");
+  if(size == NULL)
+    return gDefaultCacheSize * 1024 * 1024;
+  return (size_t)atoi(size) * 1024 * 1024;
+}
+
+MSpinLock FabricSplicePersistenceData::_cacheLock;
+size_t FabricSplicePersistenceData::_cacheBudget = readCacheBudget();
+size_t FabricSplicePersistenceData::_cacheSize = 0;
+FabricSplicePersistenceData::CacheEntryList FabricSplicePersistenceData::_cacheEntries;
+std::multimap<uint64_t, FabricSplicePersistenceData::CacheEntryList::iterator> FabricSplicePersistenceData::_cacheEntriesByHash;
+
+static const char * gBase64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void FabricSplicePersistenceData::appendBase64(const std::vector<char> & data, std::string & output)
+{
+  output.reserve(output.size() + (data.size() + 2) / 3 * 4);
+  size_t i = 0;
+  for(; i + 2 < data.size(); i += 3){
+    uint32_t value = ((uint8_t)data[i] << 16) | ((uint8_t)data[i+1] << 8) | (uint8_t)data[i+2];
+    output += gBase64Chars[(value >> 18) & 63];
+    output += gBase64Chars[(value >> 12) & 63];
+    output += gBase64Chars[(value >> 6) & 63];
+    output += gBase64Chars[value & 63];
+  }
+  if(i < data.size()){
+    uint32_t value = (uint8_t)data[i] << 16;
+    if(i + 1 < data.size())
+      value |= (uint8_t)data[i+1] << 8;
+    output += gBase64Chars[(value >> 18) & 63];
+    output += gBase64Chars[(value >> 12) & 63];
+    output += i + 1 < data.size() ? gBase64Chars[(value >> 6) & 63] : '=';
+    output += '=';
+  }
+}
+
+bool FabricSplicePersistenceData::decodeBase64(const char * data, size_t size, std::vector<char> & output)
+{
+  int table[256];
+  for(int i = 0; i < 256; ++i)
+    table[i] = -1;
+  for(int i = 0; i < 64; ++i)
+    table[(uint8_t)gBase64Chars[i]] = i;
+
+  if(size % 4 != 0)
+    return false;
+  output.clear();
+  output.reserve(size / 4 * 3);
+  for(size_t i = 0; i < size; i += 4){
+    int values[4];
+    int padding = 0;
+    for(int j = 0; j < 4; ++j){
+      uint8_t c = (uint8_t)data[i+j];
+      if(c == '=' && i + 4 == size && j >= 2){
+        values[j] = 0;
+        padding++;
+        continue;
+      }
+      if(padding > 0 || table[c] < 0)
+        return false;
+      values[j] = table[c];
+    }
+    uint32_t value = (values[0] << 18) | (values[1] << 12) | (values[2] << 6) | values[3];
+    output.push_back((char)((value >> 16) & 0xff));
+    if(padding < 2)
+      output.push_back((char)((value >> 8) & 0xff));
+    if(padding < 1)
+      output.push_back((char)(value & 0xff));
+  }
+  return true;
+}
+
+// little endian, independent of the host
+static void writeUInt(std::vector<char> & buffer, uint64_t value, int bytes)
+{
+  for(int i = 0; i < bytes; ++i)
+    buffer.push_back((char)((value >> (i * 8)) & 0xff));
+}
+
+static bool readUInt(const std::vector<char> & buffer, size_t & offset, uint64_t & value, int bytes)
+{
+  if(offset + bytes > buffer.size())
+    return false;
+  value = 0;
+  for(int i = 0; i < bytes; ++i)
+    value |= (uint64_t)(uint8_t)buffer[offset + i] << (i * 8);
+  offset += bytes;
+  return true;
+}
+
+static void writeLength(std::vector<char> & output, size_t length)
+{
+  while(length >= 255){
+    output.push_back((char)255);
+    length -= 255;
+  }
+  output.push_back((char)length);
+}
+
+static bool readLength(const uint8_t *& ip, const uint8_t * end, size_t & length)
+{
+  for(;;){
+    if(ip >= end)
+      return false;
+    uint8_t value = *ip++;
+    length += value;
+    if(value != 255)
+      return true;
+  }
+}
+
+void FabricSplicePersistenceData::compress(const char * data, size_t size, std::vector<char> & output)
+{
+  const int hashBits = 14;
+  const size_t minMatch = 4;
+  const size_t maxOffset = 65535;
+  const uint8_t * src = (const uint8_t *)data;
+
+  output.clear();
+  output.reserve(size / 2 + 16);
+
+  std::vector<size_t> table(1 << hashBits, (size_t)-1);
+  size_t anchor = 0;
+  size_t i = 0;
+  while(i + minMatch <= size){
+    uint32_t sequence;
+    memcpy(&sequence, src + i, 4);
+    uint32_t hash = (sequence * 2654435761U) >> (32 - hashBits);
+    size_t ref = table[hash];
+    table[hash] = i;
+
+    if(ref == (size_t)-1 || i - ref > maxOffset || memcmp(src + ref, src + i, minMatch) != 0){
+      i++;
+      continue;
+    }
+
+    size_t length = minMatch;
+    while(i + length < size && src[ref + length] == src[i + length])
+      length++;
+
+    // a sequence: token, literals, offset, match
+    size_t literals = i - anchor;
+    size_t matchLength = length - minMatch;
+    output.push_back((char)(((literals < 15 ? literals : 15) << 4) | (matchLength < 15 ? matchLength : 15)));
+    if(literals >= 15)
+      writeLength(output, literals - 15);
+    output.insert(output.end(), data + anchor, data + i);
+    writeUInt(output, i - ref, 2);
+    if(matchLength >= 15)
+      writeLength(output, matchLength - 15);
+
+    i += length;
+    anchor = i;
+  }
+
+  // the last sequence only holds literals
+  size_t literals = size - anchor;
+  output.push_back((char)((literals < 15 ? literals : 15) << 4));
+  if(literals >= 15)
+    writeLength(output, literals - 15);
+  output.insert(output.end(), data + anchor, data + size);
+}
+
+bool FabricSplicePersistenceData::decompress(const char * data, size_t size, size_t rawSize, std::vector<char> & output)
+{
+  const uint8_t * ip = (const uint8_t *)data;
+  const uint8_t * end = ip + size;
+
+  // each byte of the block expands to at most 255 bytes, larger sizes
+  // can only come from corrupt data and must not be reserved
+  output.clear();
+  if(rawSize / 255 > size)
+    return false;
+  output.reserve(rawSize);
+  while(ip < end){
+    uint8_t token = *ip++;
+
+    size_t literals = token >> 4;
+    if(literals == 15 && !readLength(ip, end, literals))
+      return false;
+    if(literals > (size_t)(end - ip) || output.size() + literals > rawSize)
+      return false;
+    output.insert(output.end(), (const char *)ip, (const char *)ip + literals);
+    ip += literals;
+
+    if(ip == end)
+      break;
+
+    if(end - ip < 2)
+      return false;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    size_t length = token & 15;
+    if(length == 15 && !readLength(ip, end, length))
+      return false;
+    length += 4;
+    if(offset == 0 || offset > output.size() || output.size() + length > rawSize)
+      return false;
+
+    // the match may overlap the bytes it produces
+    size_t from = output.size() - offset;
+    for(size_t i = 0; i < length; ++i)
+      output.push_back(output[from + i]);
+  }
+  return output.size() == rawSize;
+}
+
+// the section type of a number, -1 for any other value
+static int getNumberType(const FabricCore::Variant & value)
+{
+  if(value.isSInt32())
+    return 1;
+  if(value.isFloat32())
+    return 2;
+  if(value.isFloat64())
+    return 3;
+  return -1;
+}
+
+// the section type of the first number within a struct value
+static int getFieldType(const FabricCore::Variant & value)
+{
+  if(!value.isDict())
+    return getNumberType(value);
+  FabricCore::Variant::DictIter keyIter(value);
+  if(keyIter.isDone())
+    return -1;
+  return getFieldType(*keyIter.getValue());
+}
+
+// gathers the numbers of a value in the field order of the template, a struct
+// value such as a Vec3 or a Mat44 contributes one number per field. returns
+// false if the value doesn't match the fields and type of the template.
+static bool gatherFields(const FabricCore::Variant & templateValue, const FabricCore::Variant & value, int type, std::vector<const FabricCore::Variant *> & numbers)
+{
+  if(!templateValue.isDict()){
+    if(getNumberType(value) != type)
+      return false;
+    numbers.push_back(&value);
+    return true;
+  }
+  if(!value.isDict())
+    return false;
+
+  uint32_t fieldCount = 0;
+  for(FabricCore::Variant::DictIter keyIter(templateValue); !keyIter.isDone(); keyIter.next()){
+    const FabricCore::Variant * field = value.getDictValue(keyIter.getKey()->getStringData());
+    if(field == NULL || !gatherFields(*keyIter.getValue(), *field, type, numbers))
+      return false;
+    fieldCount++;
+  }
+  for(FabricCore::Variant::DictIter keyIter(value); !keyIter.isDone(); keyIter.next())
+    fieldCount--;
+  return fieldCount == 0;
+}
+
+// the fields of a struct value, each number replaced by its index within the element
+static FabricCore::Variant createFields(const FabricCore::Variant & value, int32_t & index)
+{
+  if(!value.isDict())
+    return FabricCore::Variant::CreateSInt32(index++);
+  FabricCore::Variant result = FabricCore::Variant::CreateDict();
+  for(FabricCore::Variant::DictIter keyIter(value); !keyIter.isDone(); keyIter.next())
+    result.setDictValue(keyIter.getKey()->getStringData(), createFields(*keyIter.getValue(), index));
+  return result;
+}
+
+// rebuilds a struct value from the numbers of its element
+static FabricCore::Variant fillFields(const FabricCore::Variant & fields, const FabricCore::Variant & numbers, uint32_t offset, uint32_t fieldCount, bool & valid)
+{
+  if(fields.isSInt32()){
+    int32_t index = fields.getSInt32();
+    if(index < 0 || (uint32_t)index >= fieldCount){
+      valid = false;
+      return FabricCore::Variant();
+    }
+    return *numbers.getArrayElement(offset + index);
+  }
+  if(!fields.isDict()){
+    valid = false;
+    return FabricCore::Variant();
+  }
+  FabricCore::Variant result = FabricCore::Variant::CreateDict();
+  for(FabricCore::Variant::DictIter keyIter(fields); !keyIter.isDone(); keyIter.next())
+    result.setDictValue(keyIter.getKey()->getStringData(), fillFields(*keyIter.getValue(), numbers, offset, fieldCount, valid));
+  return result;
+}
+
+// whether the array is made of numbers, or structs of numbers, of a single type,
+// suitable for a section. gathers the numbers in the order they are stored.
+static int getSectionType(const FabricCore::Variant & data, std::vector<const FabricCore::Variant *> & numbers)
+{
+  uint32_t count = data.getArraySize();
+  if(count == 0)
+    return -1;
+
+  const FabricCore::Variant * first = data.getArrayElement(0);
+  int type = getFieldType(*first);
+  if(type < 0)
+    return -1;
+
+  numbers.clear();
+  for(uint32_t i = 0; i < count; ++i){
+    if(!gatherFields(*first, *data.getArrayElement(i), type, numbers)){
+      numbers.clear();
+      return -1;
+    }
+  }
+  if(numbers.size() < gMinSectionElements){
+    numbers.clear();
+    return -1;
+  }
+  return type;
+}
+
+static FabricCore::Variant extractSections(const FabricCore::Variant & data, std::vector< std::vector<char> > & sections, std::vector<int> & types, std::vector<uint32_t> & counts, bool & hasFields)
+{
+  if(data.isDict()){
+    FabricCore::Variant result = FabricCore::Variant::CreateDict();
+    for(FabricCore::Variant::DictIter keyIter(data); !keyIter.isDone(); keyIter.next())
+      result.setDictValue(keyIter.getKey()->getStringData(), extractSections(*keyIter.getValue(), sections, types, counts, hasFields));
+    return result;
+  }
+
+  if(data.isArray()){
+    uint32_t count = data.getArraySize();
+    std::vector<const FabricCore::Variant *> numbers;
+    int type = getSectionType(data, numbers);
+    if(type < 0){
+      FabricCore::Variant result = FabricCore::Variant::CreateArray(count);
+      for(uint32_t i = 0; i < count; ++i)
+        result.arrayAppend(extractSections(*data.getArrayElement(i), sections, types, counts, hasFields));
+      return result;
+    }
+
+    sections.push_back(std::vector<char>());
+    std::vector<char> & section = sections.back();
+    section.reserve(numbers.size() * (type == 3 ? 8 : 4));
+    for(size_t i = 0; i < numbers.size(); ++i){
+      const FabricCore::Variant * element = numbers[i];
+      if(type == 1){
+        int32_t value = element->getSInt32();
+        writeUInt(section, (uint32_t)value, 4);
+      }
+      else if(type == 2){
+        float value = element->getFloat32();
+        uint32_t bits;
+        memcpy(&bits, &value, 4);
+        writeUInt(section, bits, 4);
+      }
+      else{
+        double value = element->getFloat64();
+        uint64_t bits;
+        memcpy(&bits, &value, 8);
+        writeUInt(section, bits, 8);
+      }
+    }
+    types.push_back(type);
+    counts.push_back((uint32_t)numbers.size());
+
+    FabricCore::Variant reference = FabricCore::Variant::CreateDict();
+    reference.setDictValue(gSectionKey, FabricCore::Variant::CreateSInt32((int32_t)sections.size()));
+    const FabricCore::Variant * first = data.getArrayElement(0);
+    if(first->isDict()){
+      int32_t fieldCount = 0;
+      reference.setDictValue(gSectionFieldsKey, createFields(*first, fieldCount));
+      hasFields = true;
+    }
+    return reference;
+  }
+
+  return data;
+}
+
+static void writeSection(std::vector<char> & buffer, int type, uint32_t count, const std::vector<char> & raw, bool compress)
+{
+  std::vector<char> compressed;
+  if(compress && raw.size() > 0)
+    FabricSplicePersistenceData::compress(&raw[0], raw.size(), compressed);
+  bool useCompressed = compress && compressed.size() < raw.size();
+  const std::vector<char> & stored = useCompressed ? compressed : raw;
+
+  writeUInt(buffer, type, 1);
+  writeUInt(buffer, useCompressed ? 1 : 0, 1);
+  writeUInt(buffer, 0, 2);
+  writeUInt(buffer, count, 4);
+  writeUInt(buffer, raw.size(), 8);
+  writeUInt(buffer, stored.size(), 8);
+  buffer.insert(buffer.end(), stored.begin(), stored.end());
+}
+
+MString FabricSplicePersistenceData::encode(const FabricCore::Variant & dictData, bool binary, bool compress)
+{
+  if(!binary)
+    return dictData.getJSONEncoding().getStringData();
+
+  std::vector< std::vector<char> > sections;
+  std::vector<int> types;
+  std::vector<uint32_t> counts;
+  bool hasFields = false;
+  FabricCore::Variant layout = extractSections(dictData, sections, types, counts, hasFields);
+
+  std::string layoutJSON = layout.getJSONEncoding().getStringData();
+  std::vector<char> layoutData(layoutJSON.begin(), layoutJSON.end());
+
+  std::vector<char> buffer;
+  buffer.push_back('F');
+  buffer.push_back('S');
+  buffer.push_back('P');
+  buffer.push_back('B');
+  writeUInt(buffer, hasFields ? gBinaryVersion : 1, 4);
+  writeUInt(buffer, sections.size() + 1, 4);
+  writeSection(buffer, SectionType_Layout, 0, layoutData, compress);
+  for(size_t i = 0; i < sections.size(); ++i)
+    writeSection(buffer, types[i], counts[i], sections[i], compress);
+
+  std::string result = gBinaryPrefix;
+  appendBase64(buffer, result);
+  return result.c_str();
+}
+
+bool FabricSplicePersistenceData::isBinaryEncoding(const MString & saveData)
+{
+  return strncmp(saveData.asChar(), gBinaryPrefix, strlen(gBinaryPrefix)) == 0;
+}
+
+bool FabricSplicePersistenceData::isJSONRequested()
+{
+  return getenv("FABRIC_SPLICE_PERSISTENCE_JSON") != NULL;
+}
+
+FabricSplicePersistenceData::FabricSplicePersistenceData()
+{
+  _isBinary = false;
+}
+
+bool FabricSplicePersistenceData::parse(const MString & saveData)
+{
+  _sections.clear();
+  _uncachedSaveData.clear();
+
+  // the cached data is complete, it serves as the layout as well
+  if(_cacheBudget > 0){
+    std::string key(saveData.asChar(), saveData.length());
+    if(fetchCache(key, _layout)){
+      _isBinary = false;
+      return true;
+    }
+    _uncachedSaveData.swap(key);
+  }
+
+  _isBinary = isBinaryEncoding(saveData);
+  if(!_isBinary){
+    _layout = FabricCore::Variant::CreateFromJSON(saveData.asChar());
+    return true;
+  }
+
+  std::vector<char> buffer;
+  size_t prefixLength = strlen(gBinaryPrefix);
+  if(!decodeBase64(saveData.asChar() + prefixLength, saveData.length() - prefixLength, buffer))
+    return false;
+
+  if(buffer.size() < 4 || memcmp(&buffer[0], "FSPB", 4) != 0)
+    return false;
+  size_t offset = 4;
+  uint64_t version, sectionCount;
+  if(!readUInt(buffer, offset, version, 4) || version > gBinaryVersion)
+    return false;
+  if(!readUInt(buffer, offset, sectionCount, 4) || sectionCount == 0)
+    return false;
+  // the headers of the sections take 24 bytes each
+  if(sectionCount > (buffer.size() - offset) / 24)
+    return false;
+
+  _sections.resize((size_t)sectionCount);
+  for(size_t i = 0; i < _sections.size(); ++i){
+    Section & section = _sections[i];
+    uint64_t type, compressed, reserved, count, rawSize, storedSize;
+    if(!readUInt(buffer, offset, type, 1) || !readUInt(buffer, offset, compressed, 1) ||
+      !readUInt(buffer, offset, reserved, 2) || !readUInt(buffer, offset, count, 4) ||
+      !readUInt(buffer, offset, rawSize, 8) || !readUInt(buffer, offset, storedSize, 8))
+      return false;
+    if(type > SectionType_Float64 || storedSize > buffer.size() - offset)
+      return false;
+
+    section.type = (uint8_t)type;
+    section.compressed = compressed != 0;
+    section.count = (uint32_t)count;
+    section.rawSize = rawSize;
+    section.decoded = false;
+    if(storedSize > 0)
+      section.data.assign(buffer.begin() + offset, buffer.begin() + offset + (size_t)storedSize);
+    offset += (size_t)storedSize;
+
+    uint64_t elementSize = section.type == SectionType_Float64 ? 8 : 4;
+    if(section.type != SectionType_Layout && section.count * elementSize != section.rawSize)
+      return false;
+  }
+
+  // only the layout is decoded right away
+  Section & layoutSection = _sections[0];
+  if(layoutSection.type != SectionType_Layout || !decodeSection(layoutSection))
+    return false;
+  std::string layoutJSON(layoutSection.data.begin(), layoutSection.data.end());
+  _layout = FabricCore::Variant::CreateFromJSON(layoutJSON.c_str());
+  return true;
+}
+
+bool FabricSplicePersistenceData::decodeSection(Section & section)
+{
+  if(section.decoded)
+    return true;
+  if(section.compressed){
+    std::vector<char> raw;
+    if(!decompress(section.data.size() > 0 ? &section.data[0] : NULL, section.data.size(), (size_t)section.rawSize, raw))
+      return false;
+    section.data.swap(raw);
+  }
+  if(section.data.size() != section.rawSize)
+    return false;
+  section.decoded = true;
+  return true;
+}
+
+FabricCore::Variant FabricSplicePersistenceData::resolveSections(const FabricCore::Variant & data, bool & valid)
+{
+  if(data.isDict()){
+    const FabricCore::Variant * reference = data.getDictValue(gSectionKey);
+    if(reference != NULL && reference->isSInt32()){
+      int32_t index = reference->getSInt32();
+      if(index <= 0 || index >= (int32_t)_sections.size() || !decodeSection(_sections[index])){
+        valid = false;
+        return FabricCore::Variant();
+      }
+      Section & section = _sections[index];
+
+      FabricCore::Variant result = FabricCore::Variant::CreateArray(section.count);
+      size_t offset = 0;
+      for(uint32_t i = 0; i < section.count; ++i){
+        uint64_t bits;
+        if(section.type == SectionType_Float64){
+          readUInt(section.data, offset, bits, 8);
+          double value;
+          memcpy(&value, &bits, 8);
+          result.arrayAppend(FabricCore::Variant::CreateFloat64(value));
+        }
+        else{
+          readUInt(section.data, offset, bits, 4);
+          uint32_t value32 = (uint32_t)bits;
+          if(section.type == SectionType_SInt32)
+            result.arrayAppend(FabricCore::Variant::CreateSInt32((int32_t)value32));
+          else{
+            float value;
+            memcpy(&value, &value32, 4);
+            result.arrayAppend(FabricCore::Variant::CreateFloat32(value));
+          }
+        }
+      }
+
+      const FabricCore::Variant * fields = data.getDictValue(gSectionFieldsKey);
+      if(fields == NULL)
+        return result;
+
+      int32_t fieldCount = 0;
+      createFields(*fields, fieldCount);
+      if(fieldCount == 0 || section.count % fieldCount != 0){
+        valid = false;
+        return FabricCore::Variant();
+      }
+      uint32_t elements = section.count / fieldCount;
+      FabricCore::Variant structs = FabricCore::Variant::CreateArray(elements);
+      for(uint32_t i = 0; i < elements; ++i)
+        structs.arrayAppend(fillFields(*fields, result, i * fieldCount, fieldCount, valid));
+      return structs;
+    }
+
+    FabricCore::Variant result = FabricCore::Variant::CreateDict();
+    for(FabricCore::Variant::DictIter keyIter(data); !keyIter.isDone(); keyIter.next())
+      result.setDictValue(keyIter.getKey()->getStringData(), resolveSections(*keyIter.getValue(), valid));
+    return result;
+  }
+
+  if(data.isArray()){
+    uint32_t count = data.getArraySize();
+    FabricCore::Variant result = FabricCore::Variant::CreateArray(count);
+    for(uint32_t i = 0; i < count; ++i)
+      result.arrayAppend(resolveSections(*data.getArrayElement(i), valid));
+    return result;
+  }
+
+  return data;
+}
+
+bool FabricSplicePersistenceData::getDict(FabricCore::Variant & dictData)
+{
+  bool valid = true;
+  if(!_isBinary)
+    dictData = _layout;
+  else
+    dictData = resolveSections(_layout, valid);
+
+  if(valid && _uncachedSaveData.length() > 0){
+    storeCache(_uncachedSaveData, dictData);
+    _uncachedSaveData.clear();
+  }
+  return valid;
+}
+
+// FNV-1a
+uint64_t FabricSplicePersistenceData::hashSaveData(const std::string & saveData)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t i = 0; i < saveData.length(); ++i){
+    hash ^= (unsigned char)saveData[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool FabricSplicePersistenceData::fetchCache(const std::string & saveData, FabricCore::Variant & dictData)
+{
+  uint64_t hash = hashSaveData(saveData);
+
+  _cacheLock.lock();
+  std::multimap<uint64_t, CacheEntryList::iterator>::iterator it = _cacheEntriesByHash.lower_bound(hash);
+  for(; it != _cacheEntriesByHash.end() && it->first == hash; ++it){
+    if(it->second->saveData != saveData)
+      continue;
+    _cacheEntries.splice(_cacheEntries.begin(), _cacheEntries, it->second);
+    dictData = it->second->dictData;
+    _cacheLock.unlock();
+    return true;
+  }
+  _cacheLock.unlock();
+  return false;
+}
+
+void FabricSplicePersistenceData::storeCache(const std::string & saveData, const FabricCore::Variant & dictData)
+{
+  if(saveData.length() > _cacheBudget)
+    return;
+
+  uint64_t hash = hashSaveData(saveData);
+
+  _cacheLock.lock();
+
+  // another node with the same data might have been decoded meanwhile
+  std::multimap<uint64_t, CacheEntryList::iterator>::iterator it = _cacheEntriesByHash.lower_bound(hash);
+  for(; it != _cacheEntriesByHash.end() && it->first == hash; ++it){
+    if(it->second->saveData == saveData){
+      _cacheLock.unlock();
+      return;
+    }
+  }
+
+  _cacheEntries.push_front(CacheEntry());
+  CacheEntry & entry = _cacheEntries.front();
+  entry.saveData = saveData;
+  entry.dictData = dictData;
+  _cacheEntriesByHash.insert(std::make_pair(hash, _cacheEntries.begin()));
+  _cacheSize += saveData.length();
+
+  // evict the least recently used entries
+  while(_cacheSize > _cacheBudget){
+    CacheEntryList::iterator last = --_cacheEntries.end();
+    uint64_t lastHash = hashSaveData(last->saveData);
+    it = _cacheEntriesByHash.lower_bound(lastHash);
+    for(; it != _cacheEntriesByHash.end() && it->first == lastHash; ++it){
+      if(it->second == last){
+        _cacheEntriesByHash.erase(it);
+        break;
+      }
+    }
+    _cacheSize -= last->saveData.length();
+    _cacheEntries.erase(last);
+  }
+
+  _cacheLock.unlock();
+}
+
+size_t FabricSplicePersistenceData::clearCache()
+{
+  _cacheLock.lock();
+  size_t count = _cacheEntries.size();
+  _cacheEntries.clear();
+  _cacheEntriesByHash.clear();
+  _cacheSize = 0;
+  _cacheLock.unlock();
+  return count;
+}
+
+size_t FabricSplicePersistenceData::getCacheEntryCount()
+{
+  _cacheLock.lock();
+  size_t count = _cacheEntries.size();
+  _cacheLock.unlock();
+  return count;
+}
+
+size_t FabricSplicePersistenceData::getCacheSize()
+{
+  _cacheLock.lock();
+  size_t size = _cacheSize;
+  _cacheLock.unlock();
+  return size;
+}
@@ -0,0 +1,109 @@
+#ifndef _CREATIONSPLICEPERSISTENCE_H_
+#define _CREATIONSPLICEPERSISTENCE_H_
+
+#include <FabricSplice.h>
+#include <maya/MString.h>
+#include <maya/MSpinLock.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+// the persistence data of a graph as stored in the saveData attribute.
+// besides JSON, the data can be stored in a binary encoding: the layout
+// of the graph as JSON followed by the numeric arrays of the port data,
+// including arrays of numeric structs such as Vec3 or Mat44, as raw
+// little endian sections, optionally compressed, base64 encoded
+// to fit the string attribute. the sections are only decoded once the
+// complete data is requested, the layout is enough to inspect the
+// operators of the graph.
+// the decoded data is kept in a process wide cache keyed by the saveData,
+// so that restoring the same data again (references being reloaded,
+// scenes being reopened, duplicated nodes) skips the decoding. the cache
+// is bounded by the size of the saveData of its entries, see
+// FABRIC_SPLICE_PERSISTENCE_CACHE_SIZE.
+class FabricSplicePersistenceData {
+public:
+
+  FabricSplicePersistenceData();
+
+  // accepts either encoding, returns false if the data is corrupt
+  bool parse(const MString & saveData);
+  bool isBinary() const { return _isBinary; }
+
+  // the persistence data, the arrays of the binary encoding are replaced
+  // by references to their section.
+  const FabricCore::Variant & getLayout() const { return _layout; }
+
+  // the complete persistence data, decoding the sections. returns false
+  // if a section is corrupt. can be called from worker threads.
+  bool getDict(FabricCore::Variant & dictData);
+
+  // drops all cached data, returns the number of dropped entries
+  static size_t clearCache();
+  static size_t getCacheEntryCount();
+  static size_t getCacheSize();
+
+  static MString encode(const FabricCore::Variant & dictData, bool binary, bool compress = true);
+  static bool isBinaryEncoding(const MString & saveData);
+
+  // whether FABRIC_SPLICE_PERSISTENCE_JSON requests JSON, for diffing .ma files
+  static bool isJSONRequested();
+
+  // the encodings used for the sections, shared with FabricSpliceMayaData
+  static void appendBase64(const std::vector<char> & data, std::string & output);
+  static bool decodeBase64(const char * data, size_t size, std::vector<char> & output);
+  // LZ4 like block compression
+  static void compress(const char * data, size_t size, std::vector<char> & output);
+  static bool decompress(const char * data, size_t size, size_t rawSize, std::vector<char> & output);
+
+private:
+
+  enum SectionType {
+    SectionType_Layout = 0,
+    SectionType_SInt32 = 1,
+    SectionType_Float32 = 2,
+    SectionType_Float64 = 3
+  };
+
+  struct Section {
+    uint8_t type;
+    bool compressed;
+    uint32_t count;
+    uint64_t rawSize;
+    std::vector<char> data;
+    bool decoded;
+  };
+
+  struct CacheEntry {
+    std::string saveData;
+    FabricCore::Variant dictData;
+  };
+
+  typedef std::list<CacheEntry> CacheEntryList;
+
+  static uint64_t hashSaveData(const std::string & saveData);
+  static bool fetchCache(const std::string & saveData, FabricCore::Variant & dictData);
+  static void storeCache(const std::string & saveData, const FabricCore::Variant & dictData);
+
+  bool decodeSection(Section & section);
+  FabricCore::Variant resolveSections(const FabricCore::Variant & data, bool & valid);
+
+  bool _isBinary;
+  FabricCore::Variant _layout;
+  std::vector<Section> _sections;
+  // the saveData of a cache miss, stored along the decoded data
+  std::string _uncachedSaveData;
+
+  static MSpinLock _cacheLock;
+  static size_t _cacheBudget;
+  static size_t _cacheSize;
+  // most recently used first
+  static CacheEntryList _cacheEntries;
+  static std::multimap<uint64_t, CacheEntryList::iterator> _cacheEntriesByHash;
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "FabricSplicePrefetcher.h"
+#include "plugin.h"
+
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnAnimCurve.h>
+#include <maya/MFnNumericAttribute.h>
+#include <maya/MAnimControl.h>
+#include <maya/MAngle.h>
+#include <maya/MDistance.h>
+#include <maya/MPlugArray.h>
+#include <maya/MAtomic.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <unistd.h>
+#endif
+
+FabricSplicePrefetcher::FabricSplicePrefetcher(FabricSpliceEvaluationCache * cache)
+{
+  _cache = cache;
+  _frameCount = 0;
+  _hasScheduled = false;
+  _pending = 0;
+  _prefetched = 0;
+  MThreadAsync::init();
+}
+
+FabricSplicePrefetcher::~FabricSplicePrefetcher()
+{
+  reset();
+  MThreadAsync::release();
+}
+
+void FabricSplicePrefetcher::cancel()
+{
+  // the worker stops at the next frame, its results are dropped by the cache
+  _cache->cancelInserts();
+  _hasScheduled = false;
+}
+
+void FabricSplicePrefetcher::reset()
+{
+  cancel();
+  wait();
+  _clone = FabricSplice::DGGraph();
+  _inputs.clear();
+  _cloneInputs.clear();
+  _cloneOutputs.clear();
+}
+
+void FabricSplicePrefetcher::wait()
+{
+  while(_pending > 0){
+#ifdef _WIN32
+    Sleep(1);
+#else
+    usleep(1000);
+#endif
+  }
+}
+
+bool FabricSplicePrefetcher::isTimeDriven(const std::string & portName) const
+{
+  for(size_t i = 0; i < _inputs.size(); ++i){
+    if(_inputs[i].portName == portName)
+      return _inputs[i].timeDriven || !_inputs[i].animCurve.isNull();
+  }
+  return false;
+}
+
+bool FabricSplicePrefetcher::buildClone(FabricSplice::DGGraph & graph, const MObject & node,
+  const std::vector<FabricSpliceEvaluationCache::Port> & inputs,
+  const std::vector<FabricSpliceEvaluationCache::Port> & outputs)
+{
+  MFnDependencyNode thisNode(node);
+  _graphName = thisNode.name();
+
+  // same as copyInternalData does for duplicated nodes
+  std::string jsonData = graph.getPersistenceDataJSON();
+  _clone = FabricSplice::DGGraph("mayaGraphPrefetch");
+  _clone.constructDGNode("DGNode");
+  _clone.setFromPersistenceDataJSON(jsonData.c_str());
+
+  _inputs.clear();
+  _cloneInputs.clear();
+  _cloneOutputs.clear();
+
+  for(size_t i = 0; i < inputs.size(); ++i){
+    FabricSplice::DGPort port = inputs[i].port;
+
+    Input input;
+    input.portName = port.getName();
+    input.port = _clone.getDGPort(input.portName.c_str());
+    input.valueSize = inputs[i].valueSize;
+    input.timeDriven = false;
+    input.isFloat = false;
+    if(!input.port.isValid())
+      return false;
+
+    // single scalars driven by the time or an animation curve
+    MPlug plug = thisNode.findPlug(input.portName.c_str());
+    if(!plug.isNull() && !plug.isArray() && !port.isArray() && port.getDataType() == std::string("Scalar")){
+      input.scalarUnit = port.getStringOption("scalarUnit");
+      if(plug.attribute().hasFn(MFn::kNumericAttribute))
+        input.isFloat = MFnNumericAttribute(plug.attribute()).unitType() == MFnNumericData::kFloat;
+
+      MPlugArray sources;
+      plug.connectedTo(sources, true, false);
+      if(sources.length() == 1){
+        MObject source = sources[0].node();
+        if(source.hasFn(MFn::kTime))
+          input.timeDriven = input.scalarUnit == "time";
+        else if(source.hasFn(MFn::kAnimCurveTimeToUnitless) ||
+          source.hasFn(MFn::kAnimCurveTimeToDistance) ||
+          source.hasFn(MFn::kAnimCurveTimeToAngular))
+          input.animCurve = source;
+      }
+    }
+
+    _inputs.push_back(input);
+
+    FabricSpliceEvaluationCache::Port clonePort;
+    clonePort.port = input.port;
+    clonePort.valueSize = input.valueSize;
+    _cloneInputs.push_back(clonePort);
+  }
+
+  for(size_t i = 0; i < outputs.size(); ++i){
+    FabricSpliceEvaluationCache::Port clonePort;
+    clonePort.port = _clone.getDGPort(outputs[i].port.getName());
+    clonePort.valueSize = outputs[i].valueSize;
+    if(!clonePort.port.isValid())
+      return false;
+    _cloneOutputs.push_back(clonePort);
+  }
+
+  return true;
+}
+
+// converts the value of an input at a time the same way plugToPort_scalar does
+FabricCore::RTVal FabricSplicePrefetcher::evaluateInput(const Input & input, const MTime & time)
+{
+  if(input.timeDriven)
+    return FabricSplice::constructFloat64RTVal(time.as(MTime::kSeconds));
+
+  double value = 0.0;
+  MFnAnimCurve curve(input.animCurve);
+  curve.evaluate(time, value);
+
+  if(input.scalarUnit == "angle")
+    value = MAngle(value, MAngle::internalUnit()).as(MAngle::kRadians);
+  else if(input.scalarUnit == "distance")
+    value = MDistance(value, MDistance::internalUnit()).as(MDistance::kMillimeters);
+  else if(input.isFloat)
+    value = (float)value;
+  return FabricSplice::constructFloat64RTVal(value);
+}
+
+void FabricSplicePrefetcher::schedule(FabricSplice::DGGraph & graph, const MObject & node, const MTime & time,
+  const std::vector<FabricSpliceEvaluationCache::Port> & inputs,
+  const std::vector<FabricSpliceEvaluationCache::Port> & outputs)
+{
+  if(_frameCount == 0 || _pending > 0)
+    return;
+
+  try
+  {
+    if(!_clone.isValid()){
+      if(!buildClone(graph, node, inputs, outputs)){
+        _clone = FabricSplice::DGGraph();
+        return;
+      }
+    }
+
+    // only the inputs evaluated per frame differ from the current values
+    bool hasTimeDrivenInputs = false;
+    for(size_t i = 0; i < _inputs.size(); ++i){
+      Input & input = _inputs[i];
+      if(input.timeDriven || !input.animCurve.isNull()){
+        hasTimeDrivenInputs = true;
+        continue;
+      }
+      FabricSplice::DGPort port = inputs[i].port;
+      if(port.isArray()){
+        std::vector<char> data(input.valueSize * port.getArrayCount());
+        if(data.size() > 0)
+          port.getArrayData(&data[0], data.size());
+        input.port.setArrayData(data.size() > 0 ? &data[0] : NULL, data.size());
+      }
+      else
+        input.port.setRTVal(port.getRTVal());
+    }
+
+    // without time driven inputs the node isn't evaluated again during playback
+    if(!hasTimeDrivenInputs)
+      return;
+
+    // continue where the last schedule ended, unless the time jumped
+    MTime step = MAnimControl::playbackBy() > 0.0 ? MTime(MAnimControl::playbackBy(), MTime::uiUnit()) : MTime(1.0, MTime::uiUnit());
+    MTime until = time + step * (double)_frameCount;
+    MTime from = time;
+    if(_hasScheduled && time >= _scheduledFrom && time <= _scheduledUntil)
+      from = _scheduledUntil;
+
+    Job * job = new Job();
+    job->prefetcher = this;
+    job->generation = _cache->getGeneration();
+    for(MTime frameTime = from + step; frameTime <= until && frameTime <= MAnimControl::maxTime(); frameTime += step){
+      Frame frame;
+      frame.seconds = frameTime.as(MTime::kSeconds);
+      for(size_t i = 0; i < _inputs.size(); ++i){
+        if(_inputs[i].timeDriven || !_inputs[i].animCurve.isNull())
+          frame.values.push_back(evaluateInput(_inputs[i], frameTime));
+        else
+          frame.values.push_back(FabricCore::RTVal());
+      }
+      job->frames.push_back(frame);
+    }
+
+    if(job->frames.size() == 0){
+      delete(job);
+      return;
+    }
+
+    if(!_hasScheduled || from == time)
+      _scheduledFrom = time;
+    _scheduledUntil = from + step * (double)job->frames.size();
+    _hasScheduled = true;
+
+    MAtomic::preIncrement(&_pending);
+    if(MThreadAsync::createTask(runJob, job, onJobDone, job) != MS::kSuccess){
+      MAtomic::preDecrement(&_pending);
+      delete(job);
+    }
+  }
+  catch(FabricSplice::Exception e)
+  {
+    mayaLogErrorFunc(e.what());
+    reset();
+  }
+  catch(FabricCore::Exception e)
+  {
+    mayaLogErrorFunc(e.getDesc_cstr());
+    reset();
+  }
+}
+
+void FabricSplicePrefetcher::run(Job & job)
+{
+  try
+  {
+    FabricCore::RTVal context = _clone.getEvalContext();
+    context.setMember("host", FabricSplice::constructStringRTVal("Maya"));
+    context.setMember("graph", FabricSplice::constructStringRTVal(_graphName.asChar()));
+
+    for(size_t i = 0; i < job.frames.size(); ++i){
+      if(job.generation != _cache->getGeneration())
+        break;
+
+      Frame & frame = job.frames[i];
+      for(size_t j = 0; j < _inputs.size(); ++j){
+        if(frame.values[j].isValid())
+          _inputs[j].port.setRTVal(frame.values[j]);
+      }
+      context.setMember("time", FabricSplice::constructFloat32RTVal(frame.seconds));
+
+      _clone.evaluate();
+      if(job.generation != _cache->getGeneration())
+        break;
+
+      _cache->insert(frame.seconds, _cloneInputs, _cloneOutputs, job.generation);
+      MAtomic::preIncrement(&_prefetched);
+    }
+  }
+  catch(FabricSplice::Exception e)
+  {
+    mayaLogErrorFunc(e.what());
+  }
+  catch(FabricCore::Exception e)
+  {
+    mayaLogErrorFunc(e.getDesc_cstr());
+  }
+}
+
+MThreadRetVal FabricSplicePrefetcher::runJob(void * data)
+{
+  Job * job = (Job *)data;
+  job->prefetcher->run(*job);
+  return 0;
+}
+
+void FabricSplicePrefetcher::onJobDone(void * data)
+{
+  Job * job = (Job *)data;
+  FabricSplicePrefetcher * prefetcher = job->prefetcher;
+  delete(job);
+  MAtomic::preDecrement(&prefetcher->_pending);
+}
@@ -0,0 +1,95 @@
+#ifndef _CREATIONSPLICEPREFETCHER_H_
+#define _CREATIONSPLICEPREFETCHER_H_
+
+#include "FabricSpliceEvaluationCache.h"
+
+#include <maya/MObject.h>
+#include <maya/MTime.h>
+#include <maya/MString.h>
+#include <maya/MThreadAsync.h>
+
+#include <string>
+#include <vector>
+
+// evaluates the frames following the current one on a worker thread
+// during playback, on a clone of the node's graph. the results are
+// stored in the node's evaluation cache, so that compute finds them
+// ready. inputs driven by the time node or an animation curve are
+// evaluated at the future times, all other inputs are expected to
+// keep their current values.
+class FabricSplicePrefetcher {
+public:
+
+  FabricSplicePrefetcher(FabricSpliceEvaluationCache * cache);
+  ~FabricSplicePrefetcher();
+
+  void setFrameCount(unsigned int frames) { _frameCount = frames; }
+  unsigned int getFrameCount() const { return _frameCount; }
+  unsigned int getPrefetchedCount() const { return (unsigned int)_prefetched; }
+
+  // schedules the frames following time, unless the worker is still busy
+  void schedule(FabricSplice::DGGraph & graph, const MObject & node, const MTime & time,
+    const std::vector<FabricSpliceEvaluationCache::Port> & inputs,
+    const std::vector<FabricSpliceEvaluationCache::Port> & outputs);
+
+  // drops the frames in flight without waiting for the worker, for changes of the inputs
+  void cancel();
+  // waits for the frames in flight and drops the cloned graph, for changes of ports or operators
+  void reset();
+
+  // whether the port is evaluated at the future times
+  bool isTimeDriven(const std::string & portName) const;
+
+private:
+
+  // an input of the graph, either copied as is or evaluated per frame
+  struct Input {
+    std::string portName;
+    FabricSplice::DGPort port;
+    size_t valueSize;
+    MObject animCurve;
+    bool timeDriven;
+    bool isFloat;
+    std::string scalarUnit;
+  };
+
+  struct Frame {
+    double seconds;
+    std::vector<FabricCore::RTVal> values;
+  };
+
+  struct Job {
+    FabricSplicePrefetcher * prefetcher;
+    unsigned int generation;
+    std::vector<Frame> frames;
+  };
+
+  bool buildClone(FabricSplice::DGGraph & graph, const MObject & node,
+    const std::vector<FabricSpliceEvaluationCache::Port> & inputs,
+    const std::vector<FabricSpliceEvaluationCache::Port> & outputs);
+  FabricCore::RTVal evaluateInput(const Input & input, const MTime & time);
+  void wait();
+  void run(Job & job);
+
+  static MThreadRetVal runJob(void * data);
+  static void onJobDone(void * data);
+
+  FabricSpliceEvaluationCache * _cache;
+  unsigned int _frameCount;
+
+  FabricSplice::DGGraph _clone;
+  MString _graphName;
+  std::vector<Input> _inputs;
+  std::vector<FabricSpliceEvaluationCache::Port> _cloneInputs;
+  std::vector<FabricSpliceEvaluationCache::Port> _cloneOutputs;
+
+  // the range of frames scheduled since the last cancel
+  bool _hasScheduled;
+  MTime _scheduledFrom;
+  MTime _scheduledUntil;
+
+  volatile int _pending;
+  volatile int _prefetched;
+};
+
+#endif
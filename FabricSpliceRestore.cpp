@@ -0,0 +1,330 @@
+#include "FabricSpliceRestore.h"
+#include "FabricSplicePersistence.h"
+#include "plugin.h"
+
+#include <maya/MThreadPool.h>
+#include <maya/MTimer.h>
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <stdint.h>
+
+struct RestoreTask
+{
+  FabricSpliceBaseInterface * node;
+  FabricSplicePersistenceData persistenceData;
+  std::set<uint64_t> operators;
+  MString file;
+  MString error;
+};
+
+// FNV-1a
+static uint64_t hashString(const std::string & str, uint64_t hash = 14695981039346656037ULL)
+{
+  for(size_t i = 0; i < str.length(); ++i){
+    hash ^= (unsigned char)str[i];
+    hash *= 1099511628211ULL;
+  }
+  // separates consecutive strings
+  hash ^= 0xff;
+  hash *= 1099511628211ULL;
+  return hash;
+}
+
+static std::string getDictString(const FabricCore::Variant & dict, const char * key)
+{
+  const FabricCore::Variant * value = dict.getDictValue(key);
+  if(value == NULL || !value->isString())
+    return std::string();
+  return value->getStringData();
+}
+
+// gathers the hashes of the operators' source and entry of persistence data
+static void gatherOperators(const FabricCore::Variant & data, std::set<uint64_t> & operators)
+{
+  if(data.isDict()){
+    std::string kl = getDictString(data, "kl");
+    std::string filename = getDictString(data, "filename");
+    if(kl.length() > 0 || filename.length() > 0){
+      uint64_t hash = hashString(kl);
+      hash = hashString(filename, hash);
+      hash = hashString(getDictString(data, "entry"), hash);
+      operators.insert(hash);
+      return;
+    }
+    for(FabricCore::Variant::DictIter keyIter(data); !keyIter.isDone(); keyIter.next())
+      gatherOperators(*keyIter.getValue(), operators);
+  }
+  else if(data.isArray()){
+    for(uint32_t i = 0; i < data.getArraySize(); ++i)
+      gatherOperators(*data.getArrayElement(i), operators);
+  }
+}
+
+static MThreadRetVal restoreGraph(void * data)
+{
+  RestoreTask * task = (RestoreTask *)data;
+  try
+  {
+    // the sections of binary persistence data are decoded on the workers
+    FabricCore::Variant dictData;
+    if(!task->persistenceData.getDict(dictData)){
+      task->error = "Corrupt persistence data.";
+      return 0;
+    }
+    task->node->restoreGraphFromPersistenceData(task->file, dictData);
+  }
+  catch(FabricSplice::Exception e)
+  {
+    task->error = e.what();
+  }
+  catch(FabricCore::Exception e)
+  {
+    task->error = e.getDesc_cstr();
+  }
+  return 0;
+}
+
+static void restoreGraphsParallel(void * data, MThreadRootTask * root)
+{
+  std::vector<RestoreTask*> & tasks = *(std::vector<RestoreTask*>*)data;
+  for(size_t i = 0; i < tasks.size(); ++i)
+    MThreadPool::createTask(restoreGraph, tasks[i], root);
+  MThreadPool::executeAndJoin(root);
+}
+
+static void restoreGraphs(std::vector<RestoreTask*> & tasks, bool parallel)
+{
+  if(tasks.size() == 0)
+    return;
+
+  if(tasks.size() > 1 && parallel)
+  {
+    MThreadPool::init();
+    MThreadPool::newParallelRegion(restoreGraphsParallel, &tasks);
+    MThreadPool::release();
+  }
+  else
+  {
+    for(size_t i = 0; i < tasks.size(); ++i)
+      restoreGraph(tasks[i]);
+  }
+}
+
+void restoreFromPersistenceData(const std::vector<FabricSpliceBaseInterface*> & instances, const MString & file, MStatus * stat)
+{
+  MAYASPLICE_CATCH_BEGIN(stat);
+
+  FabricSplice::Logging::AutoTimer timer("Maya::restoreFromPersistenceData(instances)");
+
+  MTimer wallTimer;
+  wallTimer.beginTimer();
+
+  // parse the persistence data and gather the operators of the nodes
+  std::vector<RestoreTask> tasks;
+  tasks.reserve(instances.size());
+  std::map<uint64_t, size_t> operatorUsers;
+  size_t operatorCount = 0;
+
+  // with lazy restore the nodes keep their saveData, the graphs are
+  // restored once they are evaluated or inspected
+  bool lazy = mayaLazyRestoreEnabled();
+  size_t deferredCount = 0;
+
+  for(size_t i = 0; i < instances.size(); ++i){
+    FabricSpliceBaseInterface * node = instances[i];
+    if(node->isRestoredFromPersistenceData() || node->isRestoreDeferred())
+      continue;
+
+    if(lazy){
+      node->deferRestoreFromPersistenceData(file);
+      deferredCount++;
+      continue;
+    }
+
+    tasks.push_back(RestoreTask());
+    RestoreTask & task = tasks.back();
+    task.node = node;
+    task.file = file;
+    if(!task.persistenceData.parse(node->getSaveData())){
+      task.error = "Corrupt persistence data.";
+      continue;
+    }
+    gatherOperators(task.persistenceData.getLayout(), task.operators);
+    operatorCount += task.operators.size();
+    for(std::set<uint64_t>::iterator it = task.operators.begin(); it != task.operators.end(); ++it)
+      operatorUsers.insert(std::make_pair(*it, tasks.size() - 1));
+  }
+
+  if(deferredCount > 0){
+    MString message("Deferred restoring ");
+    message += (int)deferredCount;
+    message += " nodes until they are evaluated or inspected.";
+    mayaLogFunc(message);
+  }
+
+  if(tasks.size() == 0)
+    return;
+
+  // compile each distinct operator once, the other nodes then reuse
+  // the compiled operators instead of compiling the same source
+  // concurrently. only the nodes which introduce all of their operators
+  // are compiled in parallel. a node which also reuses an operator of
+  // another node is restored on its own, after the nodes it shares
+  // operators with.
+  std::vector<RestoreTask*> compilingTasks;
+  std::vector<RestoreTask*> serialTasks;
+  std::vector<RestoreTask*> reusingTasks;
+  std::set<uint64_t> compiledOperators;
+  std::vector<bool> introducing(tasks.size(), false);
+  for(size_t i = 0; i < tasks.size(); ++i){
+    RestoreTask & task = tasks[i];
+    if(task.error.length() > 0)
+      continue;
+
+    bool introducesAll = task.operators.size() > 0;
+    for(std::set<uint64_t>::iterator it = task.operators.begin(); it != task.operators.end(); ++it){
+      if(operatorUsers[*it] != i)
+        introducesAll = false;
+    }
+    if(introducesAll){
+      introducing[i] = true;
+      compilingTasks.push_back(&task);
+      compiledOperators.insert(task.operators.begin(), task.operators.end());
+    }
+  }
+  for(size_t i = 0; i < tasks.size(); ++i){
+    RestoreTask & task = tasks[i];
+    if(task.error.length() > 0 || introducing[i])
+      continue;
+
+    bool compiled = true;
+    for(std::set<uint64_t>::iterator it = task.operators.begin(); it != task.operators.end(); ++it){
+      if(compiledOperators.insert(*it).second)
+        compiled = false;
+    }
+    if(compiled)
+      reusingTasks.push_back(&task);
+    else
+      serialTasks.push_back(&task);
+  }
+
+  bool parallel = mayaParallelRestoreEnabled();
+  restoreGraphs(compilingTasks, parallel);
+  restoreGraphs(serialTasks, false);
+  restoreGraphs(reusingTasks, parallel);
+
+  // report the compiler errors collected on the worker threads
+  mayaFlushLog();
+
+  // binding the graphs to the maya nodes has to happen on the main thread
+  for(size_t i = 0; i < tasks.size(); ++i){
+    RestoreTask & task = tasks[i];
+    if(task.error.length() > 0){
+      mayaLogErrorFunc(task.error);
+      if(stat)
+        *stat = MS::kFailure;
+      continue;
+    }
+    task.node->finishRestoreFromPersistenceData();
+  }
+
+  wallTimer.endTimer();
+
+  MString message("Restored ");
+  message += (int)tasks.size();
+  message += " nodes using ";
+  message += (int)operatorCount;
+  message += " operators with ";
+  message += (int)compiledOperators.size();
+  message += " distinct compiles in ";
+  message += wallTimer.elapsedTime();
+  message += " seconds.";
+  mayaLogFunc(message);
+
+  MAYASPLICE_CATCH_END(stat);
+}
+
+struct StoreTask
+{
+  FabricSpliceBaseInterface * node;
+  unsigned int generation;
+  MString file;
+  MString encoded;
+  MString error;
+};
+
+static MThreadRetVal encodeGraph(void * data)
+{
+  StoreTask * task = (StoreTask *)data;
+  try
+  {
+    task->encoded = task->node->encodePersistenceData(task->file);
+  }
+  catch(FabricSplice::Exception e)
+  {
+    task->error = e.what();
+  }
+  catch(FabricCore::Exception e)
+  {
+    task->error = e.getDesc_cstr();
+  }
+  return 0;
+}
+
+static void encodeGraphsParallel(void * data, MThreadRootTask * root)
+{
+  std::vector<StoreTask> & tasks = *(std::vector<StoreTask>*)data;
+  for(size_t i = 0; i < tasks.size(); ++i)
+    MThreadPool::createTask(encodeGraph, &tasks[i], root);
+  MThreadPool::executeAndJoin(root);
+}
+
+void storePersistenceData(const std::vector<FabricSpliceBaseInterface*> & instances, const MString & file, MStatus * stat)
+{
+  MAYASPLICE_CATCH_BEGIN(stat);
+
+  FabricSplice::Logging::AutoTimer timer("Maya::storePersistenceData(instances)");
+
+  // only the graphs which changed since they were last written
+  std::vector<StoreTask> tasks;
+  for(size_t i = 0; i < instances.size(); ++i){
+    FabricSpliceBaseInterface * node = instances[i];
+    if(!node->requiresStorePersistenceData(file))
+      continue;
+    StoreTask task;
+    task.node = node;
+    task.generation = node->getPersistenceGeneration();
+    task.file = file;
+    tasks.push_back(task);
+  }
+
+  if(tasks.size() > 1 && mayaParallelEvaluationEnabled())
+  {
+    MThreadPool::init();
+    MThreadPool::newParallelRegion(encodeGraphsParallel, &tasks);
+    MThreadPool::release();
+  }
+  else
+  {
+    for(size_t i = 0; i < tasks.size(); ++i)
+      encodeGraph(&tasks[i]);
+  }
+  mayaFlushLog();
+
+  // the plugs can only be set on the main thread
+  for(size_t i = 0; i < tasks.size(); ++i){
+    StoreTask & task = tasks[i];
+    if(task.error.length() > 0){
+      mayaLogErrorFunc(task.error);
+      if(stat)
+        *stat = MS::kFailure;
+      continue;
+    }
+    task.node->writePersistenceData(task.encoded, task.generation, task.file);
+  }
+
+  MAYASPLICE_CATCH_END(stat);
+}
@@ -0,0 +1,22 @@
+#ifndef _CREATIONSPLICERESTORE_H_
+#define _CREATIONSPLICERESTORE_H_
+
+#include "FabricSpliceBaseInterface.h"
+
+#include <vector>
+
+// restores the graphs of many nodes at once, for loading scenes. the
+// operators are gathered by the hash of their source first, then the
+// nodes introducing all of their operators are restored, followed by
+// the nodes mixing new and shared operators one at a time, and the
+// nodes only reusing already compiled ones. with parallel restore
+// enabled the first and last group are restored across worker threads.
+// with lazy restore enabled the nodes are only marked for restoring.
+void restoreFromPersistenceData(const std::vector<FabricSpliceBaseInterface*> & instances, const MString & file, MStatus * stat = 0);
+
+// stores the graphs of the nodes which changed since they were last
+// written, for saving scenes. the graphs are encoded across worker
+// threads, the saveData plugs are set on the main thread.
+void storePersistenceData(const std::vector<FabricSpliceBaseInterface*> & instances, const MString & file, MStatus * stat = 0);
+
+#endif
@@ -306,6 +306,38 @@ def testVecArray():
   res = cmds.getAttr(node + '.out[0].outX')
   assert res == 2.0
 
+def testPointArray():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  cmds.addAttr(longName='in1', dataType="pointArray")
+  cmds.addAttr(longName='out', dataType="vectorArray")
+
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Vec3[]')
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Vec3[]')
+  cmds.fabricSplice('addKLOperator', node, 'testPointArray')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testPointArray', """
+    operator testPointArray(Vec3 in1[], io Vec3 out[]) {
+      out.resize(in1.size());
+      for(Size i = 0; i < in1.size(); ++i)
+        out[i] = in1[i] + Vec3(1.0, 2.0, 3.0);
+    }
+    """)
+
+  # use an odd count so both the bulk and the remainder conversions run
+  points = [(float(i), float(i) * 2.0, float(i) * 3.0, 1.0) for i in range(7)]
+  cmds.setAttr(node + '.in1', len(points), *points, type='pointArray')
+
+  res = cmds.getAttr(node + '.out')
+  assert len(res) == len(points)
+  for i in range(len(points)):
+    assert tuple(res[i]) == (points[i][0] + 1.0, points[i][1] + 2.0, points[i][2] + 3.0)
+
+  results = cmds.fabricSplice('benchmarkConversionKernels', '', '{"count": "100000"}')
+  assert len(results) == 4
+
 def testOutMultiDirtying():
   from maya import cmds, OpenMaya
 
@@ -438,6 +470,730 @@ def testDeformer():
 
   assert round(originalPoint[1] + 5.0) == round(deformedPoint[1])
 
+  # HasNoEffect passes the input geometry through
+  cmds.setAttr(deformer + '.nodeState', 1)
+  assert round(cmds.pointPosition(sphere + '.pt[0]')[1], 3) == round(originalPoint[1], 3)
+  cmds.setAttr(deformer + '.nodeState', 0)
+  assert round(originalPoint[1] + 5.0) == round(cmds.pointPosition(sphere + '.pt[0]')[1])
+
+def testDeformerMultipleGeometries():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+  
+  sphere0 = cmds.polySphere()[0]
+  sphere1 = cmds.polySphere()[0]
+  originalPoint0 = cmds.pointPosition(sphere0 + '.pt[0]')
+  originalPoint1 = cmds.pointPosition(sphere1 + '.pt[0]')
+
+  deformer = cmds.deformer(sphere0, sphere1, type = "spliceMayaDeformer")[0]
+  cmds.select(deformer, replace = True)
+  cmds.addAttr(longName = 'in1', attributeType = "float", keyable = True, storable = True)
+
+  cmds.fabricSplice('addInputPort', deformer, 'in1', 'Scalar')
+  cmds.fabricSplice('addIOPort', deformer, 'mesh0', 'PolygonMesh')
+  cmds.fabricSplice('addIOPort', deformer, 'mesh1', 'PolygonMesh')
+  cmds.fabricSplice('addKLOperator', deformer, 'testDeformerBatch')
+  cmds.fabricSplice('setKLOperatorCode', deformer, 'testDeformerBatch', """
+    require PolygonMesh;
+
+    operator testDeformerBatch(Scalar in1, io PolygonMesh mesh0, io PolygonMesh mesh1) {
+      mesh0.setPointPosition(0, mesh0.getPointPosition(0) + Vec3(0.0, in1, 0.0));
+      mesh1.setPointPosition(0, mesh1.getPointPosition(0) + Vec3(0.0, in1 * 2.0, 0.0));
+    }
+    """)
+
+  # both geometries are deformed by a single evaluation of the graph
+  cmds.setAttr(deformer + '.in1', 5.0)
+  deformedPoint0 = cmds.pointPosition(sphere0 + '.pt[0]')
+  deformedPoint1 = cmds.pointPosition(sphere1 + '.pt[0]')
+
+  assert round(originalPoint0[1] + 5.0) == round(deformedPoint0[1])
+  assert round(originalPoint1[1] + 10.0) == round(deformedPoint1[1])
+
+def testDeformerSparse():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  sphere = cmds.polySphere()[0]
+  originalPoint0 = cmds.pointPosition(sphere + '.vtx[0]')
+  originalPoint1 = cmds.pointPosition(sphere + '.vtx[1]')
+  originalPoint2 = cmds.pointPosition(sphere + '.vtx[2]')
+
+  # only the first two vertices are members of the deformer
+  deformer = cmds.deformer(sphere + '.vtx[0:1]', type = "spliceMayaDeformer")[0]
+  cmds.select(deformer, replace = True)
+  cmds.addAttr(longName = 'in1', attributeType = "float", keyable = True, storable = True)
+
+  addMayaAttribute = False
+  cmds.fabricSplice('addInputPort', deformer, 'in1', 'Scalar')
+  cmds.fabricSplice('addIOPort', deformer, 'mesh0_points', 'Vec3[]', addMayaAttribute)
+  cmds.fabricSplice('addInputPort', deformer, 'mesh0_indices', 'UInt32[]', addMayaAttribute)
+  cmds.fabricSplice('addIOPort', deformer, 'mesh0_changed', 'Boolean[]', addMayaAttribute)
+  cmds.fabricSplice('addKLOperator', deformer, 'testDeformerSparse')
+  cmds.fabricSplice('setKLOperatorCode', deformer, 'testDeformerSparse', """
+    operator testDeformerSparse(Scalar in1, io Vec3 mesh0_points[], UInt32 mesh0_indices[], io Boolean mesh0_changed[]) {
+      mesh0_changed.resize(mesh0_points.size());
+      for(Size i=0;i<mesh0_points.size();i++) {
+        mesh0_changed[i] = mesh0_indices[i] == 0;
+        mesh0_points[i] += Vec3(0.0, in1, 0.0);
+      }
+    }
+    """)
+
+  # only the points flagged as changed are written back
+  cmds.setAttr(deformer + '.in1', 5.0)
+  assert round(originalPoint0[1] + 5.0) == round(cmds.pointPosition(sphere + '.vtx[0]')[1])
+  assert round(originalPoint1[1]) == round(cmds.pointPosition(sphere + '.vtx[1]')[1])
+  assert round(originalPoint2[1]) == round(cmds.pointPosition(sphere + '.vtx[2]')[1])
+
+  # the envelope blends the result, and disables the deformer at 0
+  cmds.setAttr(deformer + '.envelope', 0.5)
+  assert round(originalPoint0[1] + 2.5, 2) == round(cmds.pointPosition(sphere + '.vtx[0]')[1], 2)
+  cmds.setAttr(deformer + '.envelope', 0.0)
+  assert round(originalPoint0[1], 2) == round(cmds.pointPosition(sphere + '.vtx[0]')[1], 2)
+
+def testParallelEvaluation():
+  from maya import cmds, OpenMaya
+
+  # the evaluation manager only exists in maya 2016 and later
+  if not hasattr(cmds, 'evaluationManager'):
+    return
+
+  cmds.file(newFile = True, force = True)
+
+  # many independent nodes, each driving its own locator
+  nodeCount = 64
+  locators = []
+  for i in range(nodeCount):
+    node = cmds.createNode("spliceMayaNode")
+    addMayaAttribute = True
+    cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', addMayaAttribute)
+    cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', addMayaAttribute)
+    cmds.fabricSplice('addKLOperator', node, 'testParallel')
+    cmds.fabricSplice('setKLOperatorCode', node, 'testParallel', """
+      operator testParallel(Scalar in1, io Scalar out) {
+        out = 0.0;
+        for(Integer j=0;j<1000;j++)
+          out += in1 * 0.001;
+      }
+      """)
+    cmds.setKeyframe(node, attribute = 'in1', time = 1, value = 0.0, inTangentType = 'linear', outTangentType = 'linear')
+    cmds.setKeyframe(node, attribute = 'in1', time = 10, value = float(i), inTangentType = 'linear', outTangentType = 'linear')
+    locator = cmds.spaceLocator()[0]
+    cmds.connectAttr(node + '.out', locator + '.translateX')
+    locators.append(locator)
+
+  # each node ramps linearly from 0 to its index over the frames
+  def evaluateFrames():
+    for frame in range(1, 11):
+      cmds.currentTime(frame, update = True)
+      for i in range(nodeCount):
+        expected = float(i) * float(frame - 1) / 9.0
+        assert abs(cmds.getAttr(locators[i] + '.translateX') - expected) < 0.01
+
+  previousMode = cmds.evaluationManager(query = True, mode = True)[0]
+  try:
+    for mode in ['off', 'serial', 'parallel']:
+      cmds.evaluationManager(mode = mode)
+      for i in range(2):
+        evaluateFrames()
+  finally:
+    cmds.evaluationManager(mode = previousMode)
+
+def testEvaluationCache():
+  from maya import cmds, OpenMaya
+  import json
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addKLOperator', node, 'testCache')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testCache', """
+    operator testCache(Scalar in1, io Scalar out) {
+      out = in1 * 2.0;
+    }
+    """)
+  cmds.fabricSplice('setEvaluationCache', node, '{"enabled": true, "budget": 16}')
+
+  cmds.setKeyframe(node, attribute = 'in1', time = 1, value = 0.0)
+  cmds.setKeyframe(node, attribute = 'in1', time = 10, value = 9.0)
+  locator = cmds.spaceLocator()[0]
+  cmds.connectAttr(node + '.out', locator + '.translateX')
+
+  def evaluateFrames():
+    values = []
+    for frame in range(1, 11):
+      cmds.currentTime(frame, update = True)
+      values.append(round(cmds.getAttr(locator + '.translateX'), 3))
+    return values
+
+  # the second pass over the frames is served by the cache
+  firstValues = evaluateFrames()
+  stats = json.loads(cmds.fabricSplice('getEvaluationCacheStats', node))
+  assert stats['hits'] == 0
+  assert stats['entries'] == stats['misses']
+
+  assert evaluateFrames() == firstValues
+  stats = json.loads(cmds.fabricSplice('getEvaluationCacheStats', node))
+  assert stats['hits'] >= 9
+  assert firstValues[9] == 18.0
+
+  cmds.fabricSplice('clearEvaluationCache', node)
+  stats = json.loads(cmds.fabricSplice('getEvaluationCacheStats', node))
+  assert stats['entries'] == 0
+
+def testPrefetch():
+  from maya import cmds, OpenMaya
+  import json, time
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addKLOperator', node, 'testPrefetch')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testPrefetch', """
+    operator testPrefetch(Scalar in1, io Scalar out) {
+      out = in1 * 3.0;
+    }
+    """)
+  cmds.fabricSplice('setPrefetch', node, '{"frames": 4, "budget": 16}')
+
+  cmds.setKeyframe(node, attribute = 'in1', time = 1, value = 0.0)
+  cmds.setKeyframe(node, attribute = 'in1', time = 10, value = 9.0)
+  cmds.keyTangent(node, attribute = 'in1', inTangentType = 'linear', outTangentType = 'linear')
+  locator = cmds.spaceLocator()[0]
+  cmds.connectAttr(node + '.out', locator + '.translateX')
+
+  # prefetching is only scheduled by evaluations on the main thread
+  previousMode = None
+  if hasattr(cmds, 'evaluationManager'):
+    previousMode = cmds.evaluationManager(query = True, mode = True)[0]
+    cmds.evaluationManager(mode = 'off')
+
+  try:
+    cmds.playbackOptions(minTime = 1, maxTime = 10, loop = 'once')
+    cmds.currentTime(1)
+    cmds.play(wait = True)
+  finally:
+    if previousMode is not None:
+      cmds.evaluationManager(mode = previousMode)
+
+  # the prefetched frames hold the same values as evaluated ones
+  stats = json.loads(cmds.fabricSplice('getEvaluationCacheStats', node))
+  assert stats['prefetchFrames'] == 4
+  assert stats['prefetched'] > 0
+  for frame in range(1, 11):
+    cmds.currentTime(frame, update = True)
+    assert round(cmds.getAttr(locator + '.translateX'), 3) == round((frame - 1) * 3.0, 3)
+
+  cmds.fabricSplice('setPrefetch', node, '{"frames": 0}')
+
+def testContextTime():
+  from maya import cmds, OpenMaya
+  import json
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addKLOperator', node, 'testContextTime')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testContextTime', """
+    operator testContextTime(Scalar in1, io Scalar out) {
+      out = in1 * 2.0;
+    }
+    """)
+
+  cmds.currentUnit(time = 'film')
+  cmds.setKeyframe(node, attribute = 'in1', time = 1, value = 1.0)
+  cmds.setKeyframe(node, attribute = 'in1', time = 11, value = 11.0)
+  cmds.keyTangent(node, attribute = 'in1', inTangentType = 'linear', outTangentType = 'linear')
+  cmds.currentTime(1)
+
+  # evaluating at another time doesn't use the current time
+  assert round(cmds.getAttr(node + '.out', time = 6), 3) == 12.0
+  assert round(cmds.getAttr(node + '.out'), 3) == 2.0
+
+  # sub frame samples over the shutter in a single call
+  samples = cmds.fabricSplice('evaluateSamples', node, '{"time": "6", "samples": 3}')
+  assert len(samples) == 3
+  values = [json.loads(sample)['ports']['out'] for sample in samples]
+  assert [round(value, 3) for value in values] == [11.0, 12.0, 13.0]
+
+def testInvalidationQueue():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addKLOperator', node, 'testInvalidation')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testInvalidation', """
+    operator testInvalidation(Scalar in1, io Scalar out) {
+      out = in1 * 2.0;
+    }
+    """)
+
+  cmds.setAttr(node + '.in1', 3.0)
+  locators = []
+  for i in range(10):
+    locator = cmds.spaceLocator()[0]
+    cmds.connectAttr(node + '.out', locator + '.translateX')
+    locators.append(locator)
+  cmds.flushIdleQueue()
+  assert [round(cmds.getAttr(locator + '.translateX'), 3) for locator in locators] == [6.0] * 10
+
+  # recompiling dirties the outputs once maya is idle
+  cmds.fabricSplice('setKLOperatorCode', node, 'testInvalidation', """
+    operator testInvalidation(Scalar in1, io Scalar out) {
+      out = in1 * 3.0;
+    }
+    """)
+  cmds.flushIdleQueue()
+  assert [round(cmds.getAttr(locator + '.translateX'), 3) for locator in locators] == [9.0] * 10
+
+def testSceneRestore():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  # many nodes sharing a couple of operators
+  nodes = []
+  for i in range(12):
+    node = cmds.createNode("spliceMayaNode")
+    addMayaAttribute = True
+    cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', addMayaAttribute)
+    cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', addMayaAttribute)
+    if i % 2 == 0:
+      cmds.fabricSplice('addKLOperator', node, 'testRestoreDouble')
+      cmds.fabricSplice('setKLOperatorCode', node, 'testRestoreDouble', """
+        operator testRestoreDouble(Scalar in1, io Scalar out) {
+          out = in1 * 2.0;
+        }
+        """)
+    else:
+      cmds.fabricSplice('addKLOperator', node, 'testRestoreTriple')
+      cmds.fabricSplice('setKLOperatorCode', node, 'testRestoreTriple', """
+        operator testRestoreTriple(Scalar in1, io Scalar out) {
+          out = in1 * 3.0;
+        }
+        """)
+    cmds.setAttr(node + '.in1', float(i))
+    nodes.append(node)
+
+  # a node sharing an operator and introducing another one
+  mixed = cmds.createNode("spliceMayaNode")
+  cmds.fabricSplice('addInputPort', mixed, 'in1', 'Scalar', True)
+  cmds.fabricSplice('addOutputPort', mixed, 'out', 'Scalar', True)
+  cmds.fabricSplice('addKLOperator', mixed, 'testRestoreDouble')
+  cmds.fabricSplice('setKLOperatorCode', mixed, 'testRestoreDouble', """
+    operator testRestoreDouble(Scalar in1, io Scalar out) {
+      out = in1 * 2.0;
+    }
+    """)
+  cmds.fabricSplice('addKLOperator', mixed, 'testRestoreOffset')
+  cmds.fabricSplice('setKLOperatorCode', mixed, 'testRestoreOffset', """
+    operator testRestoreOffset(io Scalar out) {
+      out += 1.0;
+    }
+    """)
+  cmds.setAttr(mixed + '.in1', 5.0)
+
+  cmds.file(rename = 'testSceneRestore.ma')
+  cmds.file(f = True, save = True, type = 'mayaAscii')
+
+  for parallel in [False, True]:
+    cmds.fabricSplice('setParallelRestore', '', '{"enabled": %s}' % ('true' if parallel else 'false'))
+    try:
+      cmds.file(newFile = True, force = True)
+      cmds.file('testSceneRestore.ma', o = True)
+    finally:
+      cmds.fabricSplice('setParallelRestore', '', '{"enabled": false}')
+
+    for i in range(len(nodes)):
+      factor = 2.0 if i % 2 == 0 else 3.0
+      assert round(cmds.getAttr(nodes[i] + '.out'), 3) == float(i) * factor
+    assert round(cmds.getAttr(mixed + '.out'), 3) == 11.0
+
+def testBinaryPersistence():
+  from maya import cmds, OpenMaya
+  import json, os
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  cmds.fabricSplice('addInputPort', node, 'weights', 'Scalar[]', False)
+  cmds.fabricSplice('addInputPort', node, 'points', 'Vec3[]', False)
+  cmds.fabricSplice('addOutputPort', node, 'sum', 'Scalar', True)
+  cmds.fabricSplice('addKLOperator', node, 'testBinaryPersistence')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testBinaryPersistence', """
+    operator testBinaryPersistence(Scalar weights[], Vec3 points[], io Scalar sum) {
+      sum = 0.0;
+      for(Size i=0;i<weights.size();i++)
+        sum += weights[i];
+      for(Size i=0;i<points.size();i++)
+        sum += points[i].y;
+    }
+    """)
+  cmds.fabricSplice('setPortPersistence', node, '{"portName":"weights", "persistence":true}')
+  cmds.fabricSplice('setPortPersistence', node, '{"portName":"points", "persistence":true}')
+  weights = [0.5] * 1000
+  cmds.fabricSplice('setPortData', node, '{"portName":"weights"}', json.dumps(weights))
+  points = [{"x": 1.0, "y": 0.25, "z": 2.0}] * 100
+  cmds.fabricSplice('setPortData', node, '{"portName":"points"}', json.dumps(points))
+  assert round(cmds.getAttr(node + '.sum'), 3) == 525.0
+
+  # the persisted array data is stored in the binary encoding
+  if os.environ.get('FABRIC_SPLICE_PERSISTENCE_JSON', '') == '':
+    cmds.file(rename = 'testBinaryPersistence.ma')
+    cmds.file(f = True, save = True, type = 'mayaAscii')
+    assert cmds.getAttr(node + '.saveData').startswith('#FSPB:')
+
+    cmds.file(newFile = True, force = True)
+    cmds.file('testBinaryPersistence.ma', o = True)
+    assert round(cmds.getAttr(node + '.sum'), 3) == 525.0
+
+def testIncrementalSave():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  cmds.fabricSplice('addInputPort', node, 'value', 'Scalar', True)
+  cmds.fabricSplice('addOutputPort', node, 'result', 'Scalar', True)
+  cmds.fabricSplice('addKLOperator', node, 'testIncrementalSave')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testIncrementalSave', """
+    operator testIncrementalSave(Scalar value, io Scalar result) {
+      result = value * 2.0;
+    }
+    """)
+  cmds.setAttr(node + '.value', 2.0)
+  assert round(cmds.getAttr(node + '.result'), 3) == 4.0
+
+  cmds.file(rename = 'testIncrementalSave.ma')
+  cmds.file(f = True, save = True, type = 'mayaAscii')
+  saveData = cmds.getAttr(node + '.saveData')
+  assert saveData
+
+  # unchanged graphs are not stored again, changing inputs and
+  # evaluating doesn't change graphs without persisted outputs
+  cmds.setAttr(node + '.saveData', '', type = 'string')
+  cmds.setAttr(node + '.value', 3.0)
+  assert round(cmds.getAttr(node + '.result'), 3) == 6.0
+  cmds.file(rename = 'testIncrementalSave2.ma')
+  cmds.file(f = True, save = True, type = 'mayaAscii')
+  assert not cmds.getAttr(node + '.saveData')
+
+  # changing the operator marks the graph for storing
+  cmds.fabricSplice('setKLOperatorCode', node, 'testIncrementalSave', """
+    operator testIncrementalSave(Scalar value, io Scalar result) {
+      result = value * 3.0;
+    }
+    """)
+  cmds.file(f = True, save = True, type = 'mayaAscii')
+  assert cmds.getAttr(node + '.saveData')
+
+  cmds.file(newFile = True, force = True)
+  cmds.file('testIncrementalSave2.ma', o = True)
+  assert round(cmds.getAttr(node + '.result'), 3) == 9.0
+
+def testLazyRestore():
+  from maya import cmds, OpenMaya
+  import json
+
+  cmds.file(newFile = True, force = True)
+
+  nodes = []
+  for i in range(3):
+    node = cmds.createNode("spliceMayaNode")
+    cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', True)
+    cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', True)
+    cmds.fabricSplice('addKLOperator', node, 'testLazyRestore')
+    cmds.fabricSplice('setKLOperatorCode', node, 'testLazyRestore', """
+      operator testLazyRestore(Scalar in1, io Scalar out) {
+        out = in1 * 2.0;
+      }
+      """)
+    cmds.setAttr(node + '.in1', float(i + 1))
+    nodes.append(node)
+
+  cmds.file(rename = 'testLazyRestore.ma')
+  cmds.file(f = True, save = True, type = 'mayaAscii')
+
+  cmds.fabricSplice('setLazyRestore', '', '{"enabled": true}')
+  try:
+    cmds.file(newFile = True, force = True)
+    cmds.file('testLazyRestore.ma', o = True)
+    stats = json.loads(cmds.fabricSplice('getRestoreStats'))
+    assert stats['deferred'] == 3 and stats['restored'] == 0
+
+    # evaluating restores the node
+    assert round(cmds.getAttr(nodes[0] + '.out'), 3) == 2.0
+    stats = json.loads(cmds.fabricSplice('getRestoreStats'))
+    assert stats['deferred'] == 2 and stats['restored'] == 1
+
+    # so does inspecting it
+    cmds.fabricSplice('getKLOperatorCode', nodes[1], '{"opName":"testLazyRestore"}')
+    stats = json.loads(cmds.fabricSplice('getRestoreStats'))
+    assert stats['deferred'] == 1 and stats['restored'] == 2
+
+    # deferred nodes keep their saveData when saving
+    cmds.file(f = True, save = True, type = 'mayaAscii')
+  finally:
+    cmds.fabricSplice('setLazyRestore', '', '{"enabled": false}')
+
+  cmds.file(newFile = True, force = True)
+  cmds.file('testLazyRestore.ma', o = True)
+  for i in range(len(nodes)):
+    assert round(cmds.getAttr(nodes[i] + '.out'), 3) == float(i + 1) * 2.0
+
+def testPersistenceCache():
+  from maya import cmds, OpenMaya
+  import json
+
+  cmds.file(newFile = True, force = True)
+  cmds.fabricSplice('clearPersistenceCache')
+
+  node = cmds.createNode("spliceMayaNode", name = 'cachedNode')
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', True)
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', True)
+  cmds.fabricSplice('addKLOperator', node, 'testPersistenceCache')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testPersistenceCache', """
+    operator testPersistenceCache(Scalar in1, io Scalar out) {
+      out = in1 * 2.0;
+    }
+    """)
+  cmds.setAttr(node + '.in1', 3.0)
+
+  cmds.file(rename = 'testPersistenceCache.ma')
+  cmds.file(f = True, save = True, type = 'mayaAscii')
+
+  cmds.file(newFile = True, force = True)
+  cmds.file('testPersistenceCache.ma', o = True)
+  assert round(cmds.getAttr(node + '.out'), 3) == 6.0
+  stats = json.loads(cmds.fabricSplice('getRestoreStats'))
+  assert stats['cachedEntries'] == 1
+
+  # reopening the scene restores the graph from the cached data
+  cmds.file(newFile = True, force = True)
+  cmds.file('testPersistenceCache.ma', o = True)
+  assert round(cmds.getAttr(node + '.out'), 3) == 6.0
+  stats = json.loads(cmds.fabricSplice('getRestoreStats'))
+  assert stats['cachedEntries'] == 1
+
+  assert cmds.fabricSplice('clearPersistenceCache') == 1
+  stats = json.loads(cmds.fabricSplice('getRestoreStats'))
+  assert stats['cachedEntries'] == 0 and stats['cachedBytes'] == 0
+
+def testImportRestore():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode", name = 'importedNode')
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', True)
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Scalar', True)
+  cmds.fabricSplice('addKLOperator', node, 'testImportRestore')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testImportRestore', """
+    operator testImportRestore(Scalar in1, io Scalar out) {
+      out = in1 * 2.0;
+    }
+    """)
+  cmds.setAttr(node + '.in1', 3.0)
+  cmds.file(rename = 'testImportRestore.ma')
+  cmds.file(f = True, save = True, type = 'mayaAscii')
+
+  cmds.file(newFile = True, force = True)
+
+  # a node of the current scene, which isn't saved yet
+  local = cmds.createNode("spliceMayaNode")
+  cmds.fabricSplice('addInputPort', local, 'in1', 'Scalar', True)
+  cmds.fabricSplice('addOutputPort', local, 'out', 'Scalar', True)
+  cmds.fabricSplice('addKLOperator', local, 'testImportLocal')
+  cmds.fabricSplice('setKLOperatorCode', local, 'testImportLocal', """
+    operator testImportLocal(Scalar in1, io Scalar out) {
+      out = in1 * 5.0;
+    }
+    """)
+  cmds.setAttr(local + '.in1', 1.0)
+  assert round(cmds.getAttr(local + '.out'), 3) == 5.0
+
+  # importing and referencing keep the graphs of the existing nodes
+  cmds.file('testImportRestore.ma', i = True, namespace = 'imported')
+  cmds.file('testImportRestore.ma', r = True, namespace = 'referenced')
+  assert round(cmds.getAttr('imported:importedNode.out'), 3) == 6.0
+  assert round(cmds.getAttr('referenced:importedNode.out'), 3) == 6.0
+
+  cmds.setAttr(local + '.in1', 2.0)
+  assert round(cmds.getAttr(local + '.out'), 3) == 10.0
+
+def testPolygonMeshInput():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  cube = cmds.polyCube()[0]
+  node = cmds.createNode("spliceMayaNode")
+
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'meshIn', 'PolygonMesh', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'height', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'polygons', 'Integer', addMayaAttribute)
+  cmds.fabricSplice('addKLOperator', node, 'testMeshInput')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testMeshInput', """
+    require PolygonMesh;
+
+    operator testMeshInput(PolygonMesh meshIn, io Scalar height, io Integer polygons) {
+      height = meshIn.getPointPosition(0).y;
+      polygons = meshIn.polygonCount();
+    }
+    """)
+  cmds.connectAttr(cube + '.outMesh', node + '.meshIn')
+
+  assert cmds.getAttr(node + '.polygons') == 6
+  height = cmds.getAttr(node + '.height')
+
+  # only the points change, the topology is reused
+  cmds.move(0, 2, 0, cube + '.vtx[0]', relative = True)
+  assert round(cmds.getAttr(node + '.height') - height) == 2
+  assert cmds.getAttr(node + '.polygons') == 6
+
+  # same vertex count, different topology
+  cmds.polyTriangulate(cube)
+  assert cmds.getAttr(node + '.polygons') == 12
+
+def testPolygonMeshOutput():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'height', 'Scalar', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'meshOut', 'PolygonMesh', addMayaAttribute)
+  cmds.fabricSplice('addKLOperator', node, 'testMeshOutput')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testMeshOutput', """
+    require PolygonMesh;
+
+    operator testMeshOutput(Scalar height, io PolygonMesh meshOut) {
+      if(meshOut.polygonCount() == 0) {
+        meshOut.beginStructureChanges();
+        meshOut.createPoints(4);
+        meshOut.addPolygon(0, 1, 2, 3);
+        meshOut.endStructureChanges();
+      }
+      meshOut.setPointPosition(0, Vec3(0.0, height, 0.0));
+      meshOut.setPointPosition(1, Vec3(1.0, 0.0, 0.0));
+      meshOut.setPointPosition(2, Vec3(1.0, 0.0, 1.0));
+      meshOut.setPointPosition(3, Vec3(0.0, 0.0, 1.0));
+      meshOut.recomputePointNormals();
+    }
+    """)
+
+  shape = cmds.createNode('mesh')
+  cmds.connectAttr(node + '.meshOut', shape + '.inMesh')
+
+  # the second and third evaluation keep the topology and update the points in place
+  for height in [1.0, 2.0, 3.0]:
+    cmds.setAttr(node + '.height', height)
+    assert round(cmds.pointPosition(shape + '.vtx[0]')[1]) == height
+    assert cmds.polyEvaluate(shape, face = True) == 1
+
+def testPolygonMeshNGons():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'sides', 'Integer', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'meshOut', 'PolygonMesh', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, '{"portName":"trustedMeshOut", "dataType":"PolygonMesh", "addMayaAttr":true, "trustedTopology":true}')
+  cmds.fabricSplice('addKLOperator', node, 'testNGon')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testNGon', """
+    require PolygonMesh;
+
+    operator testNGon(Integer sides, io PolygonMesh meshOut, io PolygonMesh trustedMeshOut) {
+      meshOut.clear();
+      meshOut.beginStructureChanges();
+      meshOut.createPoints(sides);
+      LocalIndexArray indices;
+      for(Integer i = 0; i < sides; i++) {
+        Scalar angle = TWO_PI * Scalar(i) / Scalar(sides);
+        meshOut.setPointPosition(i, Vec3(cos(angle), 0.0, sin(angle)));
+        indices.push(i);
+      }
+      meshOut.addPolygon(indices);
+      meshOut.endStructureChanges();
+      meshOut.recomputePointNormals();
+      trustedMeshOut = meshOut.clone();
+    }
+    """)
+
+  shape = cmds.createNode('mesh')
+  trustedShape = cmds.createNode('mesh')
+  cmds.connectAttr(node + '.meshOut', shape + '.inMesh')
+  cmds.connectAttr(node + '.trustedMeshOut', trustedShape + '.inMesh')
+
+  for sides in [5, 8]:
+    cmds.setAttr(node + '.sides', sides)
+    assert cmds.polyEvaluate(shape, face = True) == 1
+    assert cmds.polyEvaluate(shape, vertex = True) == sides
+    assert cmds.polyEvaluate(trustedShape, vertex = True) == sides
+
+def testPolygonMeshArrayOutput():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+
+  addMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'pieces', 'Integer', addMayaAttribute)
+  cmds.fabricSplice('addOutputPort', node, 'meshes', 'PolygonMesh[]', addMayaAttribute, 'Array (Multi)')
+  cmds.fabricSplice('addKLOperator', node, 'testMeshArray')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testMeshArray', """
+    require PolygonMesh;
+
+    operator testMeshArray(Integer pieces, io PolygonMesh meshes[]) {
+      meshes.resize(pieces);
+      for(Integer i = 0; i < pieces; i++) {
+        meshes[i] = PolygonMesh();
+        meshes[i].beginStructureChanges();
+        meshes[i].createPoints(3 + i);
+        LocalIndexArray indices;
+        for(Integer j = 0; j < 3 + i; j++) {
+          Scalar angle = TWO_PI * Scalar(j) / Scalar(3 + i);
+          meshes[i].setPointPosition(j, Vec3(cos(angle), Scalar(i), sin(angle)));
+          indices.push(j);
+        }
+        meshes[i].addPolygon(indices);
+        meshes[i].endStructureChanges();
+        meshes[i].recomputePointNormals();
+      }
+    }
+    """)
+
+  cmds.setAttr(node + '.pieces', 4)
+
+  # the meshes of the array are built in parallel
+  for i in range(4):
+    shape = cmds.createNode('mesh')
+    cmds.connectAttr(node + '.meshes[%d]' % i, shape + '.inMesh')
+    assert cmds.polyEvaluate(shape, vertex = True) == 3 + i
+
 def testOperatorFile():
   from maya import cmds, OpenMaya
 
@@ -540,7 +1296,8 @@ def testSpliceMayaData():
     """)
 
   node1 = cmds.createNode("spliceMayaNode")
-  cmds.fabricSplice('addInputPort', node1, 'in1', 'Bone', addMayaAttribute, 'Single Value', addSpliceMayaAttribute)
+  # only the attribute keeps the value, it isn't part of the saveData
+  cmds.fabricSplice('addInputPort', node1, '{"portName":"in1", "dataType":"Bone", "addMayaAttr":true, "addSpliceMayaAttr":true, "storeSpliceMayaData":true}')
   cmds.fabricSplice('addInputPort', node1, 'in2', 'Scalar', addMayaAttribute, 'Single Value')
   cmds.fabricSplice('addOutputPort', node1, 'out', 'String', addMayaAttribute, 'Single Value')
   cmds.fabricSplice('addKLOperator',node1,'helloWorldOp1')
@@ -557,6 +1314,55 @@ def testSpliceMayaData():
   cmds.setAttr(node + '.in1', 1.0)
   assert cmds.getAttr(node1 + '.out') == 'hello1'
 
+def testSpliceMayaDataPersistence():
+  from maya import cmds, OpenMaya
+
+  cmds.file(newFile = True, force = True)
+
+  node = cmds.createNode("spliceMayaNode")
+  addMayaAttribute = True
+  addSpliceMayaAttribute = True
+  cmds.fabricSplice('addInputPort', node, 'in1', 'Scalar', addMayaAttribute, 'Single Value')
+  cmds.fabricSplice('addOutputPort', node, 'out', 'Bone', addMayaAttribute, 'Single Value', addSpliceMayaAttribute)
+  cmds.fabricSplice('addKLOperator', node, 'testDataPersistenceOp')
+  cmds.fabricSplice('setKLOperatorCode', node, 'testDataPersistenceOp', """
+    operator testDataPersistenceOp(Scalar in1, io Bone out) {
+      out.name = "hello" + String(Integer(in1));
+    }
+    """)
+
+  node1 = cmds.createNode("spliceMayaNode")
+  # only the attribute keeps the value, it isn't part of the saveData
+  cmds.fabricSplice('addInputPort', node1, '{"portName":"in1", "dataType":"Bone", "addMayaAttr":true, "addSpliceMayaAttr":true, "storeSpliceMayaData":true}')
+  cmds.fabricSplice('addOutputPort', node1, 'out', 'String', addMayaAttribute, 'Single Value')
+  cmds.fabricSplice('addKLOperator', node1, 'testDataPersistenceOp1')
+  cmds.fabricSplice('setKLOperatorCode', node1, 'testDataPersistenceOp1', """
+    operator testDataPersistenceOp1(Bone in1, io String out) {
+      out = in1.name;
+    }
+    """)
+
+  cmds.connectAttr(node + '.out', node1 + '.in1')
+  cmds.setAttr(node + '.in1', 7.0)
+  assert cmds.getAttr(node1 + '.out') == 'hello7'
+
+  # the value flowing between the nodes survives without its source
+  cmds.disconnectAttr(node + '.out', node1 + '.in1')
+  cmds.delete(node)
+
+  for fileType, extension in [('mayaAscii', 'ma'), ('mayaBinary', 'mb')]:
+    cmds.file(rename = 'testSpliceMayaDataPersistence.' + extension)
+    cmds.file(f = True, save = True, type = fileType)
+    cmds.file(newFile = True, force = True)
+    cmds.file('testSpliceMayaDataPersistence.' + extension, o = True)
+    assert cmds.getAttr(node1 + '.out') == 'hello7'
+
+  # without the option the wrapped values aren't stored
+  assert cmds.attributeQuery('in1', node = node1, storable = True)
+  node2 = cmds.createNode("spliceMayaNode")
+  cmds.fabricSplice('addInputPort', node2, 'in1', 'Bone', addMayaAttribute, 'Single Value', addSpliceMayaAttribute)
+  assert not cmds.attributeQuery('in1', node = node2, storable = True)
+
 def testVec3ArrayPersistence():
   from maya import cmds, OpenMaya
 
@@ -613,11 +1419,30 @@ if __name__ == '__main__':
   testEuler()
   testBaseTypesArray()
   testVecArray()
+  testPointArray()
   testOutMultiDirtying()
   testMatrixArray()
   testEulerArray()
   testDeformer()
+  testDeformerMultipleGeometries()
+  testDeformerSparse()
+  testParallelEvaluation()
+  testEvaluationCache()
+  testPrefetch()
+  testContextTime()
+  testInvalidationQueue()
+  testSceneRestore()
+  testBinaryPersistence()
+  testIncrementalSave()
+  testLazyRestore()
+  testPersistenceCache()
+  testImportRestore()
+  testPolygonMeshInput()
+  testPolygonMeshOutput()
+  testPolygonMeshNGons()
+  testPolygonMeshArrayOutput()
   testOperatorFile()
   testDuplicateNode()
   testSpliceMayaData()
+  testSpliceMayaDataPersistence()
   testVec3ArrayPersistence()
\ No newline at end of file
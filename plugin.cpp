@@ -15,6 +15,8 @@
 #include <maya/MQtUtil.h>
 #include <maya/MCommandResult.h>
 #include <maya/MFileIO.h>
+#include <maya/MTimerMessage.h>
+#include <maya/MSpinLock.h>
 
 #include <FabricSplice.h>
 #include "FabricSpliceMayaNode.h"
@@ -25,6 +27,10 @@
 #include "FabricSpliceMayaData.h"
 #include "FabricSpliceToolContext.h"
 #include "FabricSpliceRenderCallback.h"
+#include "FabricSpliceConversion.h"
+#include "FabricSpliceInvalidationQueue.h"
+#include "FabricSpliceRestore.h"
+#include "FabricSplicePersistence.h"
 
 #ifdef _MSC_VER
   #define MAYA_EXPORT extern "C" __declspec(dllexport) MStatus _cdecl
@@ -49,6 +55,11 @@ MCallbackId gOnSceneImportCallbackId;
 MCallbackId gOnSceneExportCallbackId;
 MCallbackId gOnSceneReferenceCallbackId;
 MCallbackId gOnSceneImportReferenceCallbackId;
+MCallbackId gOnSceneLoadReferenceCallbackId;
+MCallbackId gOnSceneBeforeImportCallbackId;
+MCallbackId gOnSceneBeforeReferenceCallbackId;
+MCallbackId gOnSceneBeforeImportReferenceCallbackId;
+MCallbackId gOnSceneBeforeLoadReferenceCallbackId;
 MCallbackId gRenderCallback0;
 MCallbackId gRenderCallback1;
 MCallbackId gRenderCallback2;
@@ -76,17 +87,15 @@ void onSceneSave(void *userData){
   MString file = MFileIO::beforeSaveFilename(&status);
 
   std::vector<FabricSpliceBaseInterface*> instances = FabricSpliceBaseInterface::getInstances();
-
-  for(int i = 0; i < instances.size(); ++i){
-    FabricSpliceBaseInterface *node = instances[i];
-    node->storePersistenceData(file, &status);
-  }
+  storePersistenceData(instances, file, &status);
 }
 
 void onSceneNew(void *userData){
   MGlobal::executeCommandOnIdle("unloadPlugin \"FabricSpliceManipulation.py\";");
   MGlobal::executeCommandOnIdle("loadPlugin \"FabricSpliceManipulation.py\";");
   FabricSpliceEditorWidget::postUpdateAll();
+  FabricSpliceBaseInterface::clearConversionCaches();
+  FabricSpliceBaseInterface::clearAddedInstances();
   FabricSplice::DestroyClient();
 }
 
@@ -94,21 +103,21 @@ void onSceneLoad(void *userData){
   onSceneNew(userData);
 
   if(getenv("FABRIC_SPLICE_PROFILING") != NULL)
+  {
     FabricSplice::Logging::enableTimers();
+    setConversionProfiling(true);
+  }
 
   MStatus status = MS::kSuccess;
   MString file = MFileIO::currentFile();
 
   std::vector<FabricSpliceBaseInterface*> instances = FabricSpliceBaseInterface::getInstances();
 
-  // each node will only restore once, so it's safe for import too
+  // each node will only restore once
   FabricSplice::Logging::AutoTimer persistenceTimer("Maya::onSceneLoad");
-  for(int i = 0; i < instances.size(); ++i){
-    FabricSpliceBaseInterface *node = instances[i];
-    node->restoreFromPersistenceData(file, &status); 
-    if( status != MS::kSuccess)
-      return;
-  }
+  restoreFromPersistenceData(instances, file, &status);
+  if( status != MS::kSuccess)
+    return;
   FabricSpliceEditorWidget::postUpdateAll();
 
   if(getenv("FABRIC_SPLICE_PROFILING") != NULL)
@@ -122,6 +131,29 @@ void onSceneLoad(void *userData){
   } 
 }
 
+void onSceneBeforeImport(void *userData){
+  FabricSpliceBaseInterface::beginGatherAddedInstances();
+}
+
+// imports and references only restore the nodes they added, the client
+// and the graphs of the nodes already in the scene are kept.
+void onSceneImport(void *userData){
+  std::vector<FabricSpliceBaseInterface*> instances = FabricSpliceBaseInterface::endGatherAddedInstances();
+
+  // the references of a scene being opened are restored along with it
+  if(instances.size() == 0 || MFileIO::isOpeningFile())
+    return;
+
+  MStatus status = MS::kSuccess;
+  MString file = MFileIO::currentFile();
+
+  FabricSplice::Logging::AutoTimer persistenceTimer("Maya::onSceneImport");
+  restoreFromPersistenceData(instances, file, &status);
+  if( status != MS::kSuccess)
+    return;
+  FabricSpliceEditorWidget::postUpdateAll();
+}
+
 bool gSceneIsDestroying = false;
 void onMayaExiting(void *userData){
   gSceneIsDestroying = true;
@@ -132,6 +164,7 @@ void onMayaExiting(void *userData){
     node->resetInternalData();
   }
 
+  FabricSpliceBaseInterface::clearConversionCaches();
   FabricSplice::DestroyClient(true);
 }
 
@@ -140,9 +173,113 @@ bool isDestroyingScene()
   return gSceneIsDestroying;
 }
 
+// a value unique to each thread, the address of a thread local
+MAYASPLICE_THREAD_LOCAL char gThreadTag = 0;
+void * mayaThreadTag()
+{
+  return &gThreadTag;
+}
+
+// set once on the main thread when the plugin is loaded
+MAYASPLICE_THREAD_LOCAL bool gIsMainThread = false;
+bool mayaIsMainThread()
+{
+  return gIsMainThread;
+}
+
+// messages logged on worker threads during a parallel evaluation,
+// maya's display functions may only be used on the main thread.
+struct QueuedLogMessage
+{
+  int level;
+  MString message;
+  // only used by compiler errors
+  unsigned int row;
+  unsigned int col;
+  std::string file;
+  std::string compilerLevel;
+};
+std::vector<QueuedLogMessage> gQueuedLogMessages;
+MSpinLock gQueuedLogMessagesLock;
+MCallbackId gFlushLogCallbackId;
+
+enum LogLevel
+{
+  LogLevel_Info,
+  LogLevel_Error,
+  LogLevel_KLReport,
+  LogLevel_CompilerError
+};
+
+void displayCompilerError(unsigned int row, unsigned int col, const char * file, const char * level, const char * desc)
+{
+  MString line;
+  line.set(row);
+  MGlobal::displayInfo("[KL Compiler "+MString(level)+"]: line "+line+", op '"+MString(file)+"': "+MString(desc));
+  FabricSpliceEditorWidget::reportAllCompilerError(row, col, file, level, desc);
+}
+
+void displayLogMessage(const QueuedLogMessage & queued)
+{
+  int level = queued.level;
+  const MString & message = queued.message;
+  if(level == LogLevel_CompilerError)
+    displayCompilerError(queued.row, queued.col, queued.file.c_str(), queued.compilerLevel.c_str(), message.asChar());
+  else if(level == LogLevel_Error)
+    MGlobal::displayError(MString("[Splice] ")+message);
+  else if(level == LogLevel_KLReport)
+    MGlobal::displayInfo(MString("[KL]: ")+message);
+  else
+    MGlobal::displayInfo(MString("[Splice] ")+message);
+}
+
+void logMessage(const QueuedLogMessage & queued)
+{
+  if(mayaIsMainThread())
+  {
+    mayaFlushLog();
+    displayLogMessage(queued);
+    return;
+  }
+
+  gQueuedLogMessagesLock.lock();
+  gQueuedLogMessages.push_back(queued);
+  gQueuedLogMessagesLock.unlock();
+}
+
+void logMessage(int level, const MString & message)
+{
+  QueuedLogMessage queued;
+  queued.level = level;
+  queued.message = message;
+  queued.row = 0;
+  queued.col = 0;
+  logMessage(queued);
+}
+
+void mayaFlushLog()
+{
+  if(!mayaIsMainThread())
+    return;
+
+  std::vector<QueuedLogMessage> messages;
+  gQueuedLogMessagesLock.lock();
+  messages.swap(gQueuedLogMessages);
+  gQueuedLogMessagesLock.unlock();
+
+  for(size_t i=0;i<messages.size();i++)
+    displayLogMessage(messages[i]);
+}
+
+void onFlushLog(float elapsedTime, float lastTime, void *clientData)
+{
+  mayaFlushLog();
+  FabricSpliceInvalidationQueue::schedule();
+}
+
 void mayaLogFunc(const MString & message)
 {
-  MGlobal::displayInfo(MString("[Splice] ")+message);
+  logMessage(LogLevel_Info, message);
 }
 
 void mayaLogFunc(const char * message, unsigned int length)
@@ -150,10 +287,12 @@ void mayaLogFunc(const char * message, unsigned int length)
   mayaLogFunc(MString(message));
 }
 
-bool gErrorOccured = false;
+// errors are tracked per thread, so that a failing evaluation on a
+// worker thread doesn't fail an unrelated command on the main thread.
+MAYASPLICE_THREAD_LOCAL bool gErrorOccured = false;
 void mayaLogErrorFunc(const MString & message)
 {
-  MGlobal::displayError(MString("[Splice] ")+message);
+  logMessage(LogLevel_Error, message);
   gErrorOccured = true;
 }
 
@@ -178,15 +317,55 @@ MStatus mayaErrorOccured()
 
 void mayaKLReportFunc(const char * message, unsigned int length)
 {
-  MGlobal::displayInfo(MString("[KL]: ")+MString(message));
+  logMessage(LogLevel_KLReport, MString(message));
+}
+
+// the splice nodes are declared parallel unless
+// FABRIC_SPLICE_SERIAL_EVALUATION is set
+bool gParallelEvaluationEnabled = true;
+bool mayaParallelEvaluationEnabled()
+{
+  return gParallelEvaluationEnabled;
+}
+
+// the graphs are restored once a node is first evaluated or inspected
+// instead of when loading scenes if FABRIC_SPLICE_LAZY_RESTORE is set
+bool gLazyRestoreEnabled = false;
+bool mayaLazyRestoreEnabled()
+{
+  return gLazyRestoreEnabled;
 }
 
+void mayaSetLazyRestoreEnabled(bool enabled)
+{
+  gLazyRestoreEnabled = enabled;
+}
+
+// the graphs of a scene are restored across worker threads only if
+// FABRIC_SPLICE_PARALLEL_RESTORE is set, until the core is known to
+// compile operators of different graphs concurrently without issues
+bool gParallelRestoreEnabled = false;
+bool mayaParallelRestoreEnabled()
+{
+  return gParallelRestoreEnabled;
+}
+
+void mayaSetParallelRestoreEnabled(bool enabled)
+{
+  gParallelRestoreEnabled = enabled;
+}
+
+// operators are compiled on worker threads when loading scenes
 void mayaCompilerErrorFunc(unsigned int row, unsigned int col, const char * file, const char * level, const char * desc)
 {
-  MString line;
-  line.set(row);
-  MGlobal::displayInfo("[KL Compiler "+MString(level)+"]: line "+line+", op '"+MString(file)+"': "+MString(desc));
-  FabricSpliceEditorWidget::reportAllCompilerError(row, col, file, level, desc);
+  QueuedLogMessage queued;
+  queued.level = LogLevel_CompilerError;
+  queued.message = desc;
+  queued.row = row;
+  queued.col = col;
+  queued.file = file;
+  queued.compilerLevel = level;
+  logMessage(queued);
 }
 
 void mayaKLStatusFunc(const char * topic, unsigned int topicLength,  const char * message, unsigned int messageLength)
@@ -214,6 +393,11 @@ MAYA_EXPORT initializePlugin(MObject obj)
   MFnPlugin plugin(obj, getPluginName().asChar(), "1.0", "Any");
   MStatus status;
 
+  gIsMainThread = true;
+  gParallelEvaluationEnabled = getenv("FABRIC_SPLICE_SERIAL_EVALUATION") == NULL;
+  gLazyRestoreEnabled = getenv("FABRIC_SPLICE_LAZY_RESTORE") != NULL;
+  gParallelRestoreEnabled = getenv("FABRIC_SPLICE_PARALLEL_RESTORE") != NULL;
+
   status = plugin.registerContextCommand("FabricSpliceToolContext", FabricSpliceToolContextCmd::creator, "FabricSpliceToolCommand", FabricSpliceToolCmd::creator  );
 
   loadMenu();
@@ -223,9 +407,14 @@ MAYA_EXPORT initializePlugin(MObject obj)
   gOnSceneNewCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterNew, onSceneNew);
   gOnMayaExitCallbackId = MSceneMessage::addCallback(MSceneMessage::kMayaExiting, onMayaExiting);
   gOnSceneExportCallbackId = MSceneMessage::addCallback(MSceneMessage::kBeforeExport, onSceneSave);
-  gOnSceneImportCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterImport, onSceneLoad);
-  gOnSceneReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterReference, onSceneLoad);
-  gOnSceneImportReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterImportReference, onSceneLoad);
+  gOnSceneBeforeImportCallbackId = MSceneMessage::addCallback(MSceneMessage::kBeforeImport, onSceneBeforeImport);
+  gOnSceneBeforeReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kBeforeReference, onSceneBeforeImport);
+  gOnSceneBeforeImportReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kBeforeImportReference, onSceneBeforeImport);
+  gOnSceneBeforeLoadReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kBeforeLoadReference, onSceneBeforeImport);
+  gOnSceneImportCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterImport, onSceneImport);
+  gOnSceneReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterReference, onSceneImport);
+  gOnSceneImportReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterImportReference, onSceneImport);
+  gOnSceneLoadReferenceCallbackId = MSceneMessage::addCallback(MSceneMessage::kAfterLoadReference, onSceneImport);
   gRenderCallback0 = MUiMessage::add3dViewPostRenderMsgCallback("modelPanel0", FabricSpliceRenderCallback::draw);
   gRenderCallback1 = MUiMessage::add3dViewPostRenderMsgCallback("modelPanel1", FabricSpliceRenderCallback::draw);
   gRenderCallback2 = MUiMessage::add3dViewPostRenderMsgCallback("modelPanel2", FabricSpliceRenderCallback::draw);
@@ -233,6 +422,7 @@ MAYA_EXPORT initializePlugin(MObject obj)
   gRenderCallback4 = MUiMessage::add3dViewPostRenderMsgCallback("modelPanel4", FabricSpliceRenderCallback::draw);
   gOnNodeAddedCallbackId = MDGMessage::addNodeAddedCallback(FabricSpliceBaseInterface::onNodeAdded);
   gOnNodeRemovedCallbackId = MDGMessage::addNodeRemovedCallback(FabricSpliceBaseInterface::onNodeRemoved);
+  gFlushLogCallbackId = MTimerMessage::addTimerCallback(0.25f, onFlushLog);
 
   plugin.registerData(FabricSpliceMayaData::typeName, FabricSpliceMayaData::id, FabricSpliceMayaData::creator);
 
@@ -286,6 +476,11 @@ MAYA_EXPORT uninitializePlugin(MObject obj)
   MSceneMessage::removeCallback(gOnSceneExportCallbackId);
   MSceneMessage::removeCallback(gOnSceneReferenceCallbackId);
   MSceneMessage::removeCallback(gOnSceneImportReferenceCallbackId);
+  MSceneMessage::removeCallback(gOnSceneLoadReferenceCallbackId);
+  MSceneMessage::removeCallback(gOnSceneBeforeImportCallbackId);
+  MSceneMessage::removeCallback(gOnSceneBeforeReferenceCallbackId);
+  MSceneMessage::removeCallback(gOnSceneBeforeImportReferenceCallbackId);
+  MSceneMessage::removeCallback(gOnSceneBeforeLoadReferenceCallbackId);
   MUiMessage::removeCallback(gRenderCallback0);
   MUiMessage::removeCallback(gRenderCallback1);
   MUiMessage::removeCallback(gRenderCallback2);
@@ -293,6 +488,9 @@ MAYA_EXPORT uninitializePlugin(MObject obj)
   MUiMessage::removeCallback(gRenderCallback4);
   MDGMessage::removeCallback(gOnNodeAddedCallbackId);
   MDGMessage::removeCallback(gOnNodeRemovedCallbackId);
+  MTimerMessage::removeCallback(gFlushLogCallbackId);
+  mayaFlushLog();
+  FabricSpliceInvalidationQueue::clear();
 
   plugin.deregisterData(FabricSpliceMayaData::id);
 
@@ -300,6 +498,8 @@ MAYA_EXPORT uninitializePlugin(MObject obj)
 
   plugin.deregisterContextCommand("FabricSpliceToolContext", "FabricSpliceToolCommand");
 
+  FabricSpliceBaseInterface::clearConversionCaches();
+  FabricSplicePersistenceData::clearCache();
   FabricSplice::DestroyClient();
   FabricSplice::Finalize();
   return status;
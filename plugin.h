@@ -3,6 +3,14 @@
 
 #include "Foundation.h"
 
+// thread local storage for plain data, nodes may be evaluated
+// concurrently by maya's evaluation manager.
+#if defined(_MSC_VER)
+  #define MAYASPLICE_THREAD_LOCAL __declspec(thread)
+#else
+  #define MAYASPLICE_THREAD_LOCAL __thread
+#endif
+
 MString getPluginName();
 void loadMenu();
 void unloadMenu();
@@ -15,5 +23,13 @@ void mayaLogErrorFunc(const MString & message);
 void mayaClearError();
 MStatus mayaErrorOccured();
 void mayaRefreshFunc();
+void * mayaThreadTag();
+bool mayaIsMainThread();
+void mayaFlushLog();
+bool mayaParallelEvaluationEnabled();
+bool mayaLazyRestoreEnabled();
+void mayaSetLazyRestoreEnabled(bool enabled);
+bool mayaParallelRestoreEnabled();
+void mayaSetParallelRestoreEnabled(bool enabled);
 
 #endif